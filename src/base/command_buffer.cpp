@@ -1,9 +1,14 @@
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
 #include <carbon/base/command_buffer.hpp>
 #include <carbon/base/device.hpp>
 #include <carbon/base/queue.hpp>
 #include <carbon/pipeline/descriptor_set.hpp>
 #include <carbon/pipeline/pipeline.hpp>
 #include <carbon/resource/buffer.hpp>
+#include <carbon/resource/bufferarena.hpp>
 #include <carbon/resource/stagingbuffer.hpp>
 #include <carbon/shaders/shader_stage.hpp>
 #include <carbon/utils.hpp>
@@ -15,6 +20,11 @@ void carbon::CommandBuffer::begin() {
     if (handle == nullptr)
         return;
 
+    pendingMemoryBarriers.clear();
+    pendingBufferBarriers.clear();
+    pendingImageBarriers.clear();
+    invalidateState();
+
     VkCommandBufferBeginInfo beginInfo = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
         .flags = usageFlags,
@@ -22,78 +32,348 @@ void carbon::CommandBuffer::begin() {
     vkBeginCommandBuffer(handle, &beginInfo);
 }
 
+void carbon::CommandBuffer::beginSecondary(const VkCommandBufferInheritanceRenderingInfo* renderingInfo) {
+    if (handle == nullptr)
+        return;
+
+    invalidateState();
+
+    VkCommandBufferInheritanceInfo inheritanceInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext = renderingInfo,
+    };
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = usageFlags | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &inheritanceInfo,
+    };
+    auto result = vkBeginCommandBuffer(handle, &beginInfo);
+    checkResult(result, "Failed to begin secondary command buffer");
+}
+
 void carbon::CommandBuffer::end(carbon::Queue* queue) {
     if (handle == nullptr)
         return;
 
+    flushBarriers();
     auto res = vkEndCommandBuffer(handle);
-    checkResult(std::move(queue), res, "Failed to end command buffer");
+    if (queue != nullptr) {
+        checkResult(queue, res, "Failed to end command buffer");
+    } else {
+        checkResult(res, "Failed to end command buffer");
+    }
+}
+
+void carbon::CommandBuffer::barrier(carbon::ResourceUsage srcUsage, carbon::ResourceUsage dstUsage) const {
+    const auto src = carbon::maskResourceUsageInfo(carbon::getResourceUsageInfo(srcUsage), supportedUsage);
+    const auto dst = carbon::maskResourceUsageInfo(carbon::getResourceUsageInfo(dstUsage), supportedUsage);
+    pendingMemoryBarriers.push_back({
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = src.stageMask,
+        .srcAccessMask = src.accessMask & carbon::writeAccessMask,
+        .dstStageMask = dst.stageMask,
+        .dstAccessMask = dst.accessMask,
+    });
+}
+
+void carbon::CommandBuffer::bufferBarrier(const carbon::Buffer* buffer, carbon::ResourceUsage srcUsage, carbon::ResourceUsage dstUsage,
+                                          VkDeviceSize offset, VkDeviceSize size) const {
+    bufferBarrier(buffer->getHandle(), carbon::getResourceUsageInfo(srcUsage), carbon::getResourceUsageInfo(dstUsage), offset, size);
+}
+
+void carbon::CommandBuffer::bufferBarrier(VkBuffer buffer, const carbon::ResourceUsageInfo& srcInfo,
+                                          const carbon::ResourceUsageInfo& dstInfo, VkDeviceSize offset, VkDeviceSize size) const {
+    const auto src = carbon::maskResourceUsageInfo(srcInfo, supportedUsage);
+    const auto dst = carbon::maskResourceUsageInfo(dstInfo, supportedUsage);
+
+    // There is no hazard between two reads.
+    if ((src.accessMask & carbon::writeAccessMask) == 0 && (dst.accessMask & carbon::writeAccessMask) == 0)
+        return;
+
+    pendingBufferBarriers.push_back({
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .srcStageMask = src.stageMask,
+        .srcAccessMask = src.accessMask & carbon::writeAccessMask,
+        .dstStageMask = dst.stageMask,
+        .dstAccessMask = dst.accessMask,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = buffer,
+        .offset = offset,
+        .size = size,
+    });
+}
+
+void carbon::CommandBuffer::imageBarrier(VkImage image, carbon::ResourceUsage srcUsage, carbon::ResourceUsage dstUsage,
+                                         const VkImageSubresourceRange& subresourceRange) const {
+    imageBarrier(image, carbon::getResourceUsageInfo(srcUsage), carbon::getResourceUsageInfo(dstUsage), subresourceRange);
+}
+
+void carbon::CommandBuffer::imageBarrier(VkImage image, const carbon::ResourceUsageInfo& srcInfo, const carbon::ResourceUsageInfo& dstInfo,
+                                         const VkImageSubresourceRange& subresourceRange) const {
+    const auto src = carbon::maskResourceUsageInfo(srcInfo, supportedUsage);
+    const auto dst = carbon::maskResourceUsageInfo(dstInfo, supportedUsage);
+    if (src.imageLayout == dst.imageLayout && (src.accessMask & carbon::writeAccessMask) == 0 &&
+        (dst.accessMask & carbon::writeAccessMask) == 0)
+        return;
+
+    pendingImageBarriers.push_back({
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask = src.stageMask,
+        .srcAccessMask = src.accessMask & carbon::writeAccessMask,
+        .dstStageMask = dst.stageMask,
+        .dstAccessMask = dst.accessMask,
+        .oldLayout = src.imageLayout,
+        .newLayout = dst.imageLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = subresourceRange,
+    });
+}
+
+void carbon::CommandBuffer::flushBarriers() const {
+    if (pendingMemoryBarriers.empty() && pendingBufferBarriers.empty() && pendingImageBarriers.empty())
+        return;
+
+    VkDependencyInfo dependencyInfo = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = static_cast<uint32_t>(pendingMemoryBarriers.size()),
+        .pMemoryBarriers = pendingMemoryBarriers.data(),
+        .bufferMemoryBarrierCount = static_cast<uint32_t>(pendingBufferBarriers.size()),
+        .pBufferMemoryBarriers = pendingBufferBarriers.data(),
+        .imageMemoryBarrierCount = static_cast<uint32_t>(pendingImageBarriers.size()),
+        .pImageMemoryBarriers = pendingImageBarriers.data(),
+    };
+    device->vkCmdPipelineBarrier2(handle, &dependencyInfo);
+
+    // Clearing keeps the capacity, so that later frames do not allocate.
+    pendingMemoryBarriers.clear();
+    pendingBufferBarriers.clear();
+    pendingImageBarriers.clear();
 }
 
 void carbon::CommandBuffer::beginRendering(const VkRenderingInfo* renderingInfo) const {
+    flushBarriers();
     device->vkCmdBeginRendering(handle, renderingInfo);
 }
 
+void carbon::CommandBuffer::bindDescriptorSet(carbon::Pipeline* pipeline, uint32_t set, VkDescriptorSet descriptorSet) const {
+    assert(set < maxDescriptorSets);
+
+    auto& state = getBindPointState(pipeline->getBindPoint());
+    if (state.layout != pipeline->layout) {
+        state.layout = pipeline->layout;
+        state.descriptorSets.fill(nullptr);
+    }
+
+    if (state.descriptorSets[set] == descriptorSet) {
+        ++statistics.skippedDescriptorSetBinds;
+        return;
+    }
+    state.descriptorSets[set] = descriptorSet;
+    vkCmdBindDescriptorSets(handle, pipeline->getBindPoint(), pipeline->layout, set, 1, &descriptorSet, 0, nullptr);
+}
+
 void carbon::CommandBuffer::bindDescriptorSets(carbon::Pipeline* pipeline) const {
-    std::vector<VkDescriptorSet> descriptorSets(pipeline->descriptorSets.size());
-    std::transform(pipeline->descriptorSets.begin(), pipeline->descriptorSets.end(), descriptorSets.begin(),
-                   [](std::shared_ptr<carbon::DescriptorSet> set) { return VkDescriptorSet(*set); });
+    const auto setCount = static_cast<uint32_t>(pipeline->descriptorSets.size());
+    assert(setCount <= maxDescriptorSets);
+
+    // Sets bound with a different layout are not compatible, so everything has to be rebound.
+    auto& state = getBindPointState(pipeline->getBindPoint());
+    if (state.layout != pipeline->layout) {
+        state.layout = pipeline->layout;
+        state.descriptorSets.fill(nullptr);
+    }
+
+    // Only the range between the first and the last changed set is rebound.
+    std::array<VkDescriptorSet, maxDescriptorSets> descriptorSets = {};
+    uint32_t firstChanged = setCount;
+    uint32_t lastChanged = 0;
+    for (uint32_t i = 0; i < setCount; ++i) {
+        descriptorSets[i] = VkDescriptorSet(*pipeline->descriptorSets[i]);
+        if (descriptorSets[i] != state.descriptorSets[i]) {
+            firstChanged = std::min(firstChanged, i);
+            lastChanged = i;
+        }
+    }
+
+    if (firstChanged == setCount) {
+        ++statistics.skippedDescriptorSetBinds;
+        return;
+    }
 
-    vkCmdBindDescriptorSets(handle, pipeline->getBindPoint(), pipeline->layout, 0, static_cast<uint32_t>(pipeline->descriptorSets.size()),
-                            descriptorSets.data(), 0, nullptr);
+    std::copy(descriptorSets.begin() + firstChanged, descriptorSets.begin() + lastChanged + 1, state.descriptorSets.begin() + firstChanged);
+    vkCmdBindDescriptorSets(handle, pipeline->getBindPoint(), pipeline->layout, firstChanged, lastChanged - firstChanged + 1,
+                            &descriptorSets[firstChanged], 0, nullptr);
 }
 
 void carbon::CommandBuffer::bindIndexBuffer(carbon::Buffer* buffer, VkDeviceSize offset, VkIndexType indexType) const {
-    vkCmdBindIndexBuffer(handle, buffer->handle, offset, indexType);
+    bindIndexBufferHandle(buffer->handle, offset, indexType);
 }
 
 void carbon::CommandBuffer::bindIndexBuffer(carbon::StagingBuffer* buffer, VkDeviceSize offset, VkIndexType indexType) const {
-    vkCmdBindIndexBuffer(handle, buffer->getDestinationHandle(), offset, indexType);
+    bindIndexBufferHandle(buffer->getDestinationHandle(), offset, indexType);
+}
+
+void carbon::CommandBuffer::bindIndexBuffer(const carbon::BufferArenaAllocation& allocation, VkIndexType indexType) const {
+    bindIndexBufferHandle(allocation.buffer, allocation.offset, indexType);
+}
+
+void carbon::CommandBuffer::bindIndexBufferHandle(VkBuffer buffer, VkDeviceSize offset, VkIndexType newIndexType) const {
+    if (indexBuffer == buffer && indexBufferOffset == offset && indexType == newIndexType) {
+        ++statistics.skippedIndexBufferBinds;
+        return;
+    }
+    indexBuffer = buffer;
+    indexBufferOffset = offset;
+    indexType = newIndexType;
+    vkCmdBindIndexBuffer(handle, buffer, offset, newIndexType);
 }
 
 void carbon::CommandBuffer::bindPipeline(carbon::Pipeline* pipeline) const {
+    auto& state = getBindPointState(pipeline->getBindPoint());
+    if (state.pipeline == pipeline->handle) {
+        ++statistics.skippedPipelineBinds;
+        return;
+    }
+    state.pipeline = pipeline->handle;
     vkCmdBindPipeline(handle, pipeline->getBindPoint(), pipeline->handle);
 }
 
 void carbon::CommandBuffer::bindVertexBuffer(carbon::Buffer* buffer, VkDeviceSize* offset) const {
-    vkCmdBindVertexBuffers(handle, 0, 1, &buffer->handle, offset);
+    bindVertexBufferHandle(buffer->handle, *offset);
 }
 
 void carbon::CommandBuffer::bindVertexBuffer(carbon::StagingBuffer* buffer, VkDeviceSize* offset) const {
-    auto buf = buffer->getDestinationHandle();
-    vkCmdBindVertexBuffers(handle, 0, 1, &buf, offset);
+    bindVertexBufferHandle(buffer->getDestinationHandle(), *offset);
+}
+
+void carbon::CommandBuffer::bindVertexBuffer(const carbon::BufferArenaAllocation& allocation) const {
+    bindVertexBufferHandle(allocation.buffer, allocation.offset);
+}
+
+void carbon::CommandBuffer::bindVertexBufferHandle(VkBuffer buffer, VkDeviceSize offset) const {
+    if (vertexBuffer == buffer && vertexBufferOffset == offset) {
+        ++statistics.skippedVertexBufferBinds;
+        return;
+    }
+    vertexBuffer = buffer;
+    vertexBufferOffset = offset;
+    vkCmdBindVertexBuffers(handle, 0, 1, &buffer, &offset);
 }
 
 void carbon::CommandBuffer::buildAccelerationStructures(const std::vector<VkAccelerationStructureBuildGeometryInfoKHR>& geometryInfos,
                                                         const std::vector<VkAccelerationStructureBuildRangeInfoKHR*>& rangeInfos) {
+    flushBarriers();
     device->vkCmdBuildAccelerationStructuresKHR(handle, static_cast<uint32_t>(geometryInfos.size()), geometryInfos.data(),
                                                 rangeInfos.data());
 }
 
+void carbon::CommandBuffer::blitImage(VkImage srcImage, VkImageLayout srcImageLayout, VkImage dstImage, VkImageLayout dstImageLayout,
+                                      const std::vector<VkImageBlit>& regions, VkFilter filter) const {
+    flushBarriers();
+    vkCmdBlitImage(handle, srcImage, srcImageLayout, dstImage, dstImageLayout, static_cast<uint32_t>(regions.size()), regions.data(),
+                   filter);
+}
+
+void carbon::CommandBuffer::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, const std::vector<VkBufferCopy>& regions) const {
+    flushBarriers();
+    vkCmdCopyBuffer(handle, srcBuffer, dstBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+}
+
+void carbon::CommandBuffer::copyBufferToImage(VkBuffer srcBuffer, VkImage dstImage, VkImageLayout dstImageLayout,
+                                              const std::vector<VkBufferImageCopy>& regions) const {
+    flushBarriers();
+    vkCmdCopyBufferToImage(handle, srcBuffer, dstImage, dstImageLayout, static_cast<uint32_t>(regions.size()), regions.data());
+}
+
+void carbon::CommandBuffer::copyImage(VkImage srcImage, VkImageLayout srcImageLayout, VkImage dstImage, VkImageLayout dstImageLayout,
+                                      const std::vector<VkImageCopy>& regions) const {
+    flushBarriers();
+    vkCmdCopyImage(handle, srcImage, srcImageLayout, dstImage, dstImageLayout, static_cast<uint32_t>(regions.size()), regions.data());
+}
+
+void carbon::CommandBuffer::copyImageToBuffer(VkImage srcImage, VkImageLayout srcImageLayout, VkBuffer dstBuffer,
+                                              const std::vector<VkBufferImageCopy>& regions) const {
+    flushBarriers();
+    vkCmdCopyImageToBuffer(handle, srcImage, srcImageLayout, dstBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+}
+
+void carbon::CommandBuffer::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) const {
+    flushBarriers();
+    vkCmdDispatch(handle, groupCountX, groupCountY, groupCountZ);
+}
+
 void carbon::CommandBuffer::drawIndexed(uint32_t indexCount, int32_t vertexOffset, uint32_t instanceCount, uint32_t firstIndex) const {
+    flushBarriers();
     vkCmdDrawIndexed(handle, indexCount, instanceCount, firstIndex, vertexOffset, 0);
 }
 
+void carbon::CommandBuffer::drawIndexedIndirect(const carbon::Buffer* buffer, VkDeviceSize offset, uint32_t drawCount,
+                                                uint32_t stride) const {
+    flushBarriers();
+    vkCmdDrawIndexedIndirect(handle, buffer->handle, offset, drawCount, stride);
+}
+
+void carbon::CommandBuffer::drawIndexedIndirectCount(const carbon::Buffer* buffer, VkDeviceSize offset, const carbon::Buffer* countBuffer,
+                                                     VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride) const {
+    if (!device->supportsDrawIndirectCount())
+        throw std::runtime_error("drawIndexedIndirectCount requires VK_KHR_draw_indirect_count, which is not supported");
+    flushBarriers();
+    device->vkCmdDrawIndexedIndirectCountKHR(handle, buffer->handle, offset, countBuffer->handle, countOffset, maxDrawCount, stride);
+}
+
 void carbon::CommandBuffer::endRendering() const { device->vkCmdEndRendering(handle); }
 
+void carbon::CommandBuffer::executeCommands(const std::vector<VkCommandBuffer>& cmdBuffers) const {
+    if (cmdBuffers.empty())
+        return;
+    flushBarriers();
+    vkCmdExecuteCommands(handle, static_cast<uint32_t>(cmdBuffers.size()), cmdBuffers.data());
+    // The state set by the secondary buffers is undefined afterwards.
+    invalidateState();
+}
+
+void carbon::CommandBuffer::fillBuffer(const carbon::Buffer* buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t data) const {
+    flushBarriers();
+    vkCmdFillBuffer(handle, buffer->handle, offset, size, data);
+}
+
 void carbon::CommandBuffer::pipelineBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask,
                                             VkDependencyFlags dependencyFlags, uint32_t memoryBarrierCount,
                                             const VkMemoryBarrier* pMemoryBarriers, uint32_t bufferMemoryBarrierCount,
                                             const VkBufferMemoryBarrier* pBufferMemoryBarriers, uint32_t imageMemoryBarrierCount,
                                             const VkImageMemoryBarrier* pImageMemoryBarriers) {
+    // Keep the order of barriers the same as they were recorded.
+    flushBarriers();
     vkCmdPipelineBarrier(handle, srcStageMask, dstStageMask, dependencyFlags, memoryBarrierCount, pMemoryBarriers, bufferMemoryBarrierCount,
                          pBufferMemoryBarriers, imageMemoryBarrierCount, pImageMemoryBarriers);
 }
 
-void carbon::CommandBuffer::pushConstants(carbon::Pipeline* pipeline, carbon::ShaderStage stages, uint32_t size, void* values,
+void carbon::CommandBuffer::pushConstants(carbon::Pipeline* pipeline, carbon::ShaderStage stages, uint32_t size, const void* values,
                                           uint32_t offset) const {
     vkCmdPushConstants(handle, pipeline->layout, static_cast<VkShaderStageFlags>(stages), offset, size, values);
 }
 
-void carbon::CommandBuffer::setScissor(VkRect2D* scissor) const { vkCmdSetScissor(handle, 0, 1, scissor); }
+void carbon::CommandBuffer::setScissor(VkRect2D* newScissor) const {
+    if (scissorSet && scissor.offset.x == newScissor->offset.x && scissor.offset.y == newScissor->offset.y &&
+        scissor.extent.width == newScissor->extent.width && scissor.extent.height == newScissor->extent.height) {
+        ++statistics.skippedScissors;
+        return;
+    }
+    scissor = *newScissor;
+    scissorSet = true;
+    vkCmdSetScissor(handle, 0, 1, newScissor);
+}
 
 void carbon::CommandBuffer::setViewport(float width, float height, float maxDepth, float x, float y, float minDepth) const {
-    VkViewport viewport = {
+    if (viewportSet && viewport.x == x && viewport.y == y && viewport.width == width && viewport.height == height &&
+        viewport.minDepth == minDepth && viewport.maxDepth == maxDepth) {
+        ++statistics.skippedViewports;
+        return;
+    }
+    viewport = {
         .x = x,
         .y = y,
         .width = width,
@@ -101,12 +381,14 @@ void carbon::CommandBuffer::setViewport(float width, float height, float maxDept
         .minDepth = minDepth,
         .maxDepth = maxDepth,
     };
+    viewportSet = true;
     vkCmdSetViewport(handle, 0, 1, &viewport);
 }
 
 void carbon::CommandBuffer::traceRays(VkStridedDeviceAddressRegionKHR* rayGenSbt, VkStridedDeviceAddressRegionKHR* missSbt,
                                       VkStridedDeviceAddressRegionKHR* hitSbt, VkStridedDeviceAddressRegionKHR* callableSbt,
                                       VkExtent3D imageSize) {
+    flushBarriers();
     device->vkCmdTraceRaysKHR(handle, rayGenSbt, missSbt, hitSbt, callableSbt, imageSize.width, imageSize.height, imageSize.depth);
 }
 
@@ -115,4 +397,28 @@ void carbon::CommandBuffer::setCheckpoint(const char* checkpoint) {
         device->vkCmdSetCheckpointNV(handle, checkpoint);
 }
 
+auto carbon::CommandBuffer::getBindPointState(VkPipelineBindPoint bindPoint) const -> BindPointState& {
+    switch (bindPoint) {
+        default:
+        case VK_PIPELINE_BIND_POINT_GRAPHICS: return bindPoints[0];
+        case VK_PIPELINE_BIND_POINT_COMPUTE: return bindPoints[1];
+        case VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR: return bindPoints[2];
+    }
+}
+
+void carbon::CommandBuffer::invalidateState() const {
+    bindPoints = {};
+    indexBuffer = nullptr;
+    indexBufferOffset = 0;
+    indexType = VK_INDEX_TYPE_MAX_ENUM;
+    vertexBuffer = nullptr;
+    vertexBufferOffset = 0;
+    viewportSet = false;
+    scissorSet = false;
+}
+
+auto carbon::CommandBuffer::getStatistics() const -> const carbon::CommandBufferStatistics& { return statistics; }
+
+void carbon::CommandBuffer::resetStatistics() { statistics = {}; }
+
 carbon::CommandBuffer::operator VkCommandBuffer() const { return handle; }
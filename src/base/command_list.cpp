@@ -0,0 +1,249 @@
+#include <cassert>
+#include <cstring>
+
+#include <carbon/base/command_buffer.hpp>
+#include <carbon/base/command_list.hpp>
+#include <carbon/resource/buffer.hpp>
+
+carbon::CommandList::CommandList(size_t reservedSize) { stream.reserve(reservedSize); }
+
+template <typename T>
+auto carbon::CommandList::read(size_t offset) const -> T {
+    assert(offset + sizeof(T) <= stream.size());
+    T command;
+    std::memcpy(&command, stream.data() + offset, sizeof(T));
+    return command;
+}
+
+template <typename T>
+void carbon::CommandList::write(size_t offset, const T& command) {
+    assert(offset + sizeof(T) <= stream.size());
+    std::memcpy(stream.data() + offset, &command, sizeof(T));
+}
+
+auto carbon::CommandList::append(CommandType type, const void* command, size_t commandSize, const void* data,
+                                 size_t dataSize) -> carbon::CommandHandle {
+    const auto offset = stream.size();
+    const auto size = carbon::Buffer::alignedSize(sizeof(CommandHeader) + commandSize + dataSize, commandAlignment);
+    stream.resize(offset + size);
+
+    write(offset, CommandHeader { type, static_cast<uint32_t>(size) });
+    std::memcpy(stream.data() + offset + sizeof(CommandHeader), command, commandSize);
+    if (dataSize != 0)
+        std::memcpy(stream.data() + offset + sizeof(CommandHeader) + commandSize, data, dataSize);
+
+    ++commandCount;
+    return static_cast<carbon::CommandHandle>(offset);
+}
+
+auto carbon::CommandList::getPayloadOffset(carbon::CommandHandle handle, CommandType type) const -> size_t {
+    [[maybe_unused]] const auto header = read<CommandHeader>(handle);
+    assert(header.type == type);
+    return handle + sizeof(CommandHeader);
+}
+
+void carbon::CommandList::clear() {
+    stream.clear();
+    commandCount = 0;
+}
+
+void carbon::CommandList::replay(carbon::CommandBuffer* cmdBuffer) const {
+    size_t offset = 0;
+    while (offset < stream.size()) {
+        const auto header = read<CommandHeader>(offset);
+        const auto payload = offset + sizeof(CommandHeader);
+
+        switch (header.type) {
+            case CommandType::Barrier: {
+                const auto command = read<BarrierCommand>(payload);
+                cmdBuffer->barrier(command.srcUsage, command.dstUsage);
+                break;
+            }
+            case CommandType::BindDescriptorSet: {
+                const auto command = read<BindDescriptorSetCommand>(payload);
+                cmdBuffer->bindDescriptorSet(command.pipeline, command.set, command.descriptorSet);
+                break;
+            }
+            case CommandType::BindDescriptorSets: cmdBuffer->bindDescriptorSets(read<carbon::Pipeline*>(payload)); break;
+            case CommandType::BindIndexBuffer: {
+                const auto command = read<BindIndexBufferCommand>(payload);
+                cmdBuffer->bindIndexBuffer(command.buffer, command.offset, command.indexType);
+                break;
+            }
+            case CommandType::BindPipeline: cmdBuffer->bindPipeline(read<carbon::Pipeline*>(payload)); break;
+            case CommandType::BindVertexBuffer: {
+                auto command = read<BindVertexBufferCommand>(payload);
+                cmdBuffer->bindVertexBuffer(command.buffer, &command.offset);
+                break;
+            }
+            case CommandType::BufferBarrier: {
+                const auto command = read<BufferBarrierCommand>(payload);
+                cmdBuffer->bufferBarrier(command.buffer, command.srcUsage, command.dstUsage, command.offset, command.size);
+                break;
+            }
+            case CommandType::Dispatch: {
+                const auto command = read<DispatchCommand>(payload);
+                cmdBuffer->dispatch(command.groupCountX, command.groupCountY, command.groupCountZ);
+                break;
+            }
+            case CommandType::DrawIndexed: {
+                const auto command = read<DrawIndexedCommand>(payload);
+                cmdBuffer->drawIndexed(command.indexCount, command.vertexOffset, command.instanceCount, command.firstIndex);
+                break;
+            }
+            case CommandType::DrawIndexedIndirect: {
+                const auto command = read<DrawIndexedIndirectCommand>(payload);
+                cmdBuffer->drawIndexedIndirect(command.buffer, command.offset, command.drawCount, command.stride);
+                break;
+            }
+            case CommandType::DrawIndexedIndirectCount: {
+                const auto command = read<DrawIndexedIndirectCommand>(payload);
+                cmdBuffer->drawIndexedIndirectCount(command.buffer, command.offset, command.countBuffer, command.countOffset,
+                                                    command.drawCount, command.stride);
+                break;
+            }
+            case CommandType::ImageBarrier: {
+                const auto command = read<ImageBarrierCommand>(payload);
+                cmdBuffer->imageBarrier(command.image, command.srcUsage, command.dstUsage, command.subresourceRange);
+                break;
+            }
+            case CommandType::PushConstants: {
+                const auto command = read<PushConstantsCommand>(payload);
+                cmdBuffer->pushConstants(command.pipeline, command.stages, command.size,
+                                         stream.data() + payload + sizeof(PushConstantsCommand), command.offset);
+                break;
+            }
+            case CommandType::SetScissor: {
+                auto scissor = read<VkRect2D>(payload);
+                cmdBuffer->setScissor(&scissor);
+                break;
+            }
+            case CommandType::SetViewport: {
+                const auto command = read<SetViewportCommand>(payload);
+                cmdBuffer->setViewport(command.width, command.height, command.maxDepth, command.x, command.y, command.minDepth);
+                break;
+            }
+            case CommandType::TraceRays: {
+                auto command = read<TraceRaysCommand>(payload);
+                cmdBuffer->traceRays(&command.rayGenSbt, &command.missSbt, &command.hitSbt, &command.callableSbt, command.imageSize);
+                break;
+            }
+        }
+
+        offset += header.size;
+    }
+}
+
+auto carbon::CommandList::barrier(carbon::ResourceUsage srcUsage, carbon::ResourceUsage dstUsage) -> carbon::CommandHandle {
+    return append(CommandType::Barrier, BarrierCommand { srcUsage, dstUsage });
+}
+
+auto carbon::CommandList::bindDescriptorSet(carbon::Pipeline* pipeline, uint32_t set,
+                                            VkDescriptorSet descriptorSet) -> carbon::CommandHandle {
+    return append(CommandType::BindDescriptorSet, BindDescriptorSetCommand { pipeline, descriptorSet, set });
+}
+
+auto carbon::CommandList::bindDescriptorSets(carbon::Pipeline* pipeline) -> carbon::CommandHandle {
+    return append(CommandType::BindDescriptorSets, pipeline);
+}
+
+auto carbon::CommandList::bindIndexBuffer(carbon::Buffer* buffer, VkDeviceSize offset, VkIndexType indexType) -> carbon::CommandHandle {
+    return append(CommandType::BindIndexBuffer, BindIndexBufferCommand { buffer, offset, indexType });
+}
+
+auto carbon::CommandList::bindPipeline(carbon::Pipeline* pipeline) -> carbon::CommandHandle {
+    return append(CommandType::BindPipeline, pipeline);
+}
+
+auto carbon::CommandList::bindVertexBuffer(carbon::Buffer* buffer, VkDeviceSize offset) -> carbon::CommandHandle {
+    return append(CommandType::BindVertexBuffer, BindVertexBufferCommand { buffer, offset });
+}
+
+auto carbon::CommandList::bufferBarrier(const carbon::Buffer* buffer, carbon::ResourceUsage srcUsage, carbon::ResourceUsage dstUsage,
+                                        VkDeviceSize offset, VkDeviceSize size) -> carbon::CommandHandle {
+    return append(CommandType::BufferBarrier, BufferBarrierCommand { buffer, offset, size, srcUsage, dstUsage });
+}
+
+auto carbon::CommandList::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) -> carbon::CommandHandle {
+    return append(CommandType::Dispatch, DispatchCommand { groupCountX, groupCountY, groupCountZ });
+}
+
+auto carbon::CommandList::drawIndexed(uint32_t indexCount, int32_t vertexOffset, uint32_t instanceCount,
+                                      uint32_t firstIndex) -> carbon::CommandHandle {
+    return append(CommandType::DrawIndexed, DrawIndexedCommand { indexCount, instanceCount, firstIndex, vertexOffset });
+}
+
+auto carbon::CommandList::drawIndexedIndirect(const carbon::Buffer* buffer, VkDeviceSize offset, uint32_t drawCount,
+                                              uint32_t stride) -> carbon::CommandHandle {
+    return append(CommandType::DrawIndexedIndirect, DrawIndexedIndirectCommand { buffer, nullptr, offset, 0, drawCount, stride });
+}
+
+auto carbon::CommandList::drawIndexedIndirectCount(const carbon::Buffer* buffer, VkDeviceSize offset, const carbon::Buffer* countBuffer,
+                                                   VkDeviceSize countOffset, uint32_t maxDrawCount,
+                                                   uint32_t stride) -> carbon::CommandHandle {
+    return append(CommandType::DrawIndexedIndirectCount,
+                  DrawIndexedIndirectCommand { buffer, countBuffer, offset, countOffset, maxDrawCount, stride });
+}
+
+auto carbon::CommandList::imageBarrier(VkImage image, carbon::ResourceUsage srcUsage, carbon::ResourceUsage dstUsage,
+                                       const VkImageSubresourceRange& subresourceRange) -> carbon::CommandHandle {
+    return append(CommandType::ImageBarrier, ImageBarrierCommand { image, subresourceRange, srcUsage, dstUsage });
+}
+
+auto carbon::CommandList::pushConstants(carbon::Pipeline* pipeline, carbon::ShaderStage stages, uint32_t size, const void* values,
+                                        uint32_t offset) -> carbon::CommandHandle {
+    const PushConstantsCommand command = { pipeline, stages, offset, size };
+    return append(CommandType::PushConstants, &command, sizeof(command), values, size);
+}
+
+auto carbon::CommandList::setScissor(const VkRect2D& scissor) -> carbon::CommandHandle { return append(CommandType::SetScissor, scissor); }
+
+auto carbon::CommandList::setViewport(float width, float height, float maxDepth, float x, float y,
+                                      float minDepth) -> carbon::CommandHandle {
+    return append(CommandType::SetViewport, SetViewportCommand { width, height, maxDepth, x, y, minDepth });
+}
+
+auto carbon::CommandList::traceRays(const VkStridedDeviceAddressRegionKHR& rayGenSbt, const VkStridedDeviceAddressRegionKHR& missSbt,
+                                    const VkStridedDeviceAddressRegionKHR& hitSbt, const VkStridedDeviceAddressRegionKHR& callableSbt,
+                                    VkExtent3D imageSize) -> carbon::CommandHandle {
+    return append(CommandType::TraceRays, TraceRaysCommand { rayGenSbt, missSbt, hitSbt, callableSbt, imageSize });
+}
+
+void carbon::CommandList::patchDescriptorSet(carbon::CommandHandle handle, VkDescriptorSet descriptorSet) {
+    const auto payload = getPayloadOffset(handle, CommandType::BindDescriptorSet);
+    auto command = read<BindDescriptorSetCommand>(payload);
+    command.descriptorSet = descriptorSet;
+    write(payload, command);
+}
+
+void carbon::CommandList::patchDispatch(carbon::CommandHandle handle, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+    write(getPayloadOffset(handle, CommandType::Dispatch), DispatchCommand { groupCountX, groupCountY, groupCountZ });
+}
+
+void carbon::CommandList::patchDrawIndexed(carbon::CommandHandle handle, uint32_t indexCount, uint32_t instanceCount) {
+    const auto payload = getPayloadOffset(handle, CommandType::DrawIndexed);
+    auto command = read<DrawIndexedCommand>(payload);
+    command.indexCount = indexCount;
+    command.instanceCount = instanceCount;
+    write(payload, command);
+}
+
+void carbon::CommandList::patchDrawCount(carbon::CommandHandle handle, uint32_t drawCount) {
+    const auto type = read<CommandHeader>(handle).type;
+    assert(type == CommandType::DrawIndexedIndirect || type == CommandType::DrawIndexedIndirectCount);
+    const auto payload = getPayloadOffset(handle, type);
+    auto command = read<DrawIndexedIndirectCommand>(payload);
+    command.drawCount = drawCount;
+    write(payload, command);
+}
+
+void carbon::CommandList::patchPushConstants(carbon::CommandHandle handle, const void* values, uint32_t size, uint32_t offset) {
+    const auto payload = getPayloadOffset(handle, CommandType::PushConstants);
+    [[maybe_unused]] const auto command = read<PushConstantsCommand>(payload);
+    assert(offset + size <= command.size);
+    std::memcpy(stream.data() + payload + sizeof(PushConstantsCommand) + offset, values, size);
+}
+
+auto carbon::CommandList::getCommandCount() const -> uint32_t { return commandCount; }
+
+auto carbon::CommandList::getSize() const -> size_t { return stream.size(); }
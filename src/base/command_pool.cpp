@@ -1,6 +1,7 @@
 #include <carbon/base/command_buffer.hpp>
 #include <carbon/base/command_pool.hpp>
 #include <carbon/base/device.hpp>
+#include <carbon/base/physical_device.hpp>
 #include <carbon/utils.hpp>
 
 carbon::CommandPool::CommandPool(std::shared_ptr<carbon::Device> device, std::string name)
@@ -15,6 +16,16 @@ void carbon::CommandPool::create(const uint32_t queueFamilyIndex, const VkComman
 
     vkCreateCommandPool(*device, &commandPoolCreateInfo, nullptr, &handle);
 
+    auto physicalDevice = device->getPhysicalDevice();
+    supportedUsage = carbon::getSupportedUsage(physicalDevice->getQueueFamilyFlags(queueFamilyIndex));
+    // The ray tracing stages and accesses are only valid if their extensions are enabled.
+    if (!physicalDevice->supportsExtension(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME))
+        supportedUsage.stageMask &= ~VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR;
+    if (!physicalDevice->supportsExtension(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME)) {
+        supportedUsage.stageMask &= ~VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR;
+        supportedUsage.accessMask &= ~(VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR);
+    }
+
     device->setDebugUtilsName(handle, name);
 }
 
@@ -30,7 +41,9 @@ std::shared_ptr<carbon::CommandBuffer> carbon::CommandPool::allocateBuffer(VkCom
     VkCommandBuffer cmdBuffer = nullptr;
     auto res = vkAllocateCommandBuffers(*device, &allocateInfo, &cmdBuffer);
     checkResult(res, "Failed to allocate command buffer");
-    return std::make_shared<carbon::CommandBuffer>(cmdBuffer, device.get(), bufferUsageFlags);
+    auto commandBuffer = std::make_shared<carbon::CommandBuffer>(cmdBuffer, device.get(), bufferUsageFlags);
+    commandBuffer->supportedUsage = supportedUsage;
+    return commandBuffer;
 }
 
 std::vector<std::shared_ptr<carbon::CommandBuffer>>
@@ -51,6 +64,7 @@ carbon::CommandPool::allocateBuffers(VkCommandBufferLevel level, VkCommandBuffer
 
     for (size_t i = 0; i < cmdBuffers.size(); ++i) {
         commandBuffers[i] = std::make_shared<carbon::CommandBuffer>(cmdBuffers[i], device.get(), bufferUsageFlags);
+        commandBuffers[i]->supportedUsage = supportedUsage;
     }
 
     return commandBuffers;
@@ -70,3 +84,8 @@ void carbon::CommandPool::freeBuffers(std::initializer_list<carbon::CommandBuffe
 
     vkFreeCommandBuffers(*device, handle, static_cast<uint32_t>(vkCommandBuffers.size()), vkCommandBuffers.data());
 }
+
+void carbon::CommandPool::reset(VkCommandPoolResetFlags flags) {
+    auto result = vkResetCommandPool(*device, handle, flags);
+    checkResult(result, "Failed to reset command pool");
+}
@@ -0,0 +1,73 @@
+#include <cassert>
+#include <utility>
+
+#include <fmt/core.h>
+
+#include <carbon/base/command_buffer.hpp>
+#include <carbon/base/command_pool.hpp>
+#include <carbon/base/command_pool_manager.hpp>
+#include <carbon/base/fence.hpp>
+
+carbon::CommandPoolManager::CommandPoolManager(std::shared_ptr<carbon::Device> device, std::string name)
+    : device(std::move(device)), name(std::move(name)) {}
+
+carbon::CommandPoolManager::~CommandPoolManager() = default;
+
+void carbon::CommandPoolManager::create(uint32_t queueFamilyIndex, uint32_t framesInFlight, uint32_t threadCount) {
+    pools.resize(framesInFlight);
+    for (uint32_t frame = 0; frame < framesInFlight; ++frame) {
+        pools[frame].resize(threadCount);
+        for (uint32_t thread = 0; thread < threadCount; ++thread) {
+            auto& threadPools = pools[frame][thread];
+            threadPools.pool = std::make_unique<carbon::CommandPool>(device, fmt::format("{}_frame{}_thread{}", name, frame, thread));
+            threadPools.pool->create(queueFamilyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+        }
+    }
+}
+
+void carbon::CommandPoolManager::destroy() {
+    // Destroying a pool frees all of its command buffers as well.
+    for (auto& frame : pools) {
+        for (auto& threadPools : frame)
+            threadPools.pool->destroy();
+    }
+    pools.clear();
+}
+
+auto carbon::CommandPoolManager::getCommandBuffer(uint32_t frameIndex, uint32_t threadIndex, VkCommandBufferLevel level,
+                                                  VkCommandBufferUsageFlags usageFlags) -> carbon::CommandBuffer* {
+    assert(frameIndex < pools.size() && threadIndex < pools[frameIndex].size());
+    auto& threadPools = pools[frameIndex][threadIndex];
+
+    const bool primary = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    auto& buffers = primary ? threadPools.primaryBuffers : threadPools.secondaryBuffers;
+    auto& used = primary ? threadPools.usedPrimaryBuffers : threadPools.usedSecondaryBuffers;
+
+    // Only allocate a new command buffer if every existing one is already in use this frame.
+    if (used == buffers.size())
+        buffers.push_back(threadPools.pool->allocateBuffer(level, usageFlags));
+
+    auto* cmdBuffer = buffers[used++].get();
+    cmdBuffer->usageFlags = usageFlags;
+    return cmdBuffer;
+}
+
+void carbon::CommandPoolManager::resetFrame(uint32_t frameIndex, carbon::Fence* fence) {
+    assert(frameIndex < pools.size());
+    if (fence != nullptr)
+        fence->wait();
+
+    for (auto& threadPools : pools[frameIndex]) {
+        if (threadPools.usedPrimaryBuffers == 0 && threadPools.usedSecondaryBuffers == 0)
+            continue;
+        threadPools.pool->reset();
+        threadPools.usedPrimaryBuffers = 0;
+        threadPools.usedSecondaryBuffers = 0;
+    }
+}
+
+auto carbon::CommandPoolManager::getFrameCount() const -> uint32_t { return static_cast<uint32_t>(pools.size()); }
+
+auto carbon::CommandPoolManager::getThreadCount() const -> uint32_t {
+    return pools.empty() ? 0 : static_cast<uint32_t>(pools.front().size());
+}
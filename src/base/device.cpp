@@ -1,5 +1,9 @@
+#include <algorithm>
+
 #include <carbon/base/device.hpp>
+#include <carbon/base/memory_budget.hpp>
 #include <carbon/base/physical_device.hpp>
+#include <carbon/base/queue.hpp>
 #include <carbon/utils.hpp>
 
 #define DEVICE_FUNCTION_POINTER(name) name = this->getFunctionAddress<PFN_##name>(#name);
@@ -25,6 +29,7 @@ void carbon::Device::create(std::shared_ptr<carbon::PhysicalDevice> newPhysicalD
     DEVICE_FUNCTION_POINTER(vkCmdBeginRendering)
     DEVICE_FUNCTION_POINTER(vkCmdBuildAccelerationStructuresKHR)
     DEVICE_FUNCTION_POINTER(vkCmdEndRendering)
+    DEVICE_FUNCTION_POINTER(vkCmdPipelineBarrier2)
     DEVICE_FUNCTION_POINTER(vkCmdSetCheckpointNV)
     DEVICE_FUNCTION_POINTER(vkCmdTraceRaysKHR)
     DEVICE_FUNCTION_POINTER(vkDestroyAccelerationStructureKHR)
@@ -35,10 +40,60 @@ void carbon::Device::create(std::shared_ptr<carbon::PhysicalDevice> newPhysicalD
     DEVICE_FUNCTION_POINTER(vkGetSwapchainImagesKHR)
     DEVICE_FUNCTION_POINTER(vkSetDebugUtilsObjectNameEXT)
     DEVICE_FUNCTION_POINTER(vkQueuePresentKHR)
+    DEVICE_FUNCTION_POINTER(vkQueueSubmit2)
+
+    // VK_KHR_draw_indirect_count is only desired. Some drivers return function pointers for
+    // extensions which have not been enabled, so the pointer stays null without the extension.
+    if (physicalDevice->supportsExtension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+        DEVICE_FUNCTION_POINTER(vkCmdDrawIndexedIndirectCountKHR)
 }
 
 void carbon::Device::destroy() const { vkb::destroy_device(handle); }
 
+size_t carbon::Device::collectRetired() {
+    std::vector<std::function<void()>> completed;
+    {
+        std::scoped_lock lock(retireMutex);
+        for (auto& [queue, objects] : retiredObjects) {
+            // Query the timeline once per queue instead of once per object.
+            const auto completedValue = queue->getCompletedValue();
+            while (!objects.empty() && objects.front().value <= completedValue) {
+                completed.push_back(std::move(objects.front().destroy));
+                objects.pop_front();
+            }
+        }
+    }
+
+    // The destroy functions may retire or track other objects, so they run without the lock.
+    for (auto& destroy : completed)
+        destroy();
+    return completed.size();
+}
+
+void carbon::Device::flushRetired() {
+    std::map<const carbon::Queue*, std::deque<RetiredObject>> objects;
+    {
+        std::scoped_lock lock(retireMutex);
+        std::swap(objects, retiredObjects);
+    }
+
+    for (auto& [queue, queueObjects] : objects) {
+        if (!queueObjects.empty())
+            queue->wait(queueObjects.back().value);
+        for (auto& object : queueObjects)
+            object.destroy();
+    }
+}
+
+void carbon::Device::retire(const carbon::Queue* queue, uint64_t value, std::function<void()> destroy) {
+    std::scoped_lock lock(retireMutex);
+    auto& objects = retiredObjects[queue];
+    // Keep the values of each queue sorted so that collecting can stop at the first incomplete one.
+    if (!objects.empty())
+        value = std::max(value, objects.back().value);
+    objects.push_back({ value, std::move(destroy) });
+}
+
 VkResult carbon::Device::waitIdle() const {
     if (handle.device != nullptr) {
         return vkDeviceWaitIdle(handle);
@@ -58,12 +113,42 @@ void carbon::Device::createDescriptorPool(const uint32_t maxSets, const std::vec
     vkCreateDescriptorPool(handle, &descriptorPoolCreateInfo, nullptr, descriptorPool);
 }
 
+std::pair<VkQueue, uint32_t> carbon::Device::findQueue(vkb::QueueType queueType) const {
+    if (queueType == vkb::QueueType::compute || queueType == vkb::QueueType::transfer) {
+        auto dedicatedIndex = handle.get_dedicated_queue_index(queueType);
+        if (dedicatedIndex.has_value())
+            return { getFromVkbResult(handle.get_dedicated_queue(queueType)), dedicatedIndex.value() };
+
+        // vk-bootstrap only returns compute and transfer queues from families without graphics.
+        auto separateIndex = handle.get_queue_index(queueType);
+        if (separateIndex.has_value())
+            return { getFromVkbResult(handle.get_queue(queueType)), separateIndex.value() };
+
+        queueType = vkb::QueueType::graphics;
+    }
+    return { getQueue(queueType), getQueueIndex(queueType) };
+}
+
 VkQueue carbon::Device::getQueue(const vkb::QueueType queueType) const { return getFromVkbResult(handle.get_queue(queueType)); }
 
 uint32_t carbon::Device::getQueueIndex(const vkb::QueueType queueType) const { return getFromVkbResult(handle.get_queue_index(queueType)); }
 
+std::shared_ptr<std::mutex> carbon::Device::getQueueMutex(VkQueue queue) const {
+    std::scoped_lock lock(queueMutexesMutex);
+    auto& mutex = queueMutexes[queue];
+    if (mutex == nullptr)
+        mutex = std::make_shared<std::mutex>();
+    return mutex;
+}
+
+carbon::MemoryBudget* carbon::Device::getMemoryBudget() const { return memoryBudget.get(); }
+
 std::shared_ptr<carbon::PhysicalDevice> carbon::Device::getPhysicalDevice() const { return physicalDevice; }
 
+bool carbon::Device::supportsDrawIndirectCount() const { return vkCmdDrawIndexedIndirectCountKHR != nullptr; }
+
+void carbon::Device::setMemoryBudget(std::shared_ptr<carbon::MemoryBudget> budget) { memoryBudget = std::move(budget); }
+
 void carbon::Device::setDebugUtilsName(const VkAccelerationStructureKHR& as, const std::string& name) const {
     setDebugUtilsName<VkAccelerationStructureKHR>(as, name, VK_OBJECT_TYPE_ACCELERATION_STRUCTURE_KHR);
 }
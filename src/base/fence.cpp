@@ -4,8 +4,6 @@
 #include <carbon/base/fence.hpp>
 #include <carbon/utils.hpp>
 
-#define DEFAULT_FENCE_TIMEOUT 100000000000
-
 carbon::Fence::Fence(std::shared_ptr<carbon::Device> device, std::string name) : device(std::move(device)), name(std::move(name)) {}
 
 carbon::Fence::Fence(const carbon::Fence& fence) : device(fence.device), name(fence.name), handle(fence.handle) {}
@@ -29,15 +27,26 @@ void carbon::Fence::destroy() const {
         vkDestroyFence(*device, handle, nullptr);
 }
 
-void carbon::Fence::wait() {
-    // Waiting on fences is totally thread safe.
-    auto result = vkWaitForFences(*device, 1, &handle, true, DEFAULT_FENCE_TIMEOUT);
+void carbon::Fence::wait(uint64_t timeout) {
+    // Waiting on fences is totally thread safe. A timeout is reported as an error, as the
+    // callers go on to reuse whatever the fence guards.
+    auto result = vkWaitForFences(*device, 1, &handle, true, timeout);
     checkResult(result, "Failed waiting on fences");
 }
 
+bool carbon::Fence::tryWait(uint64_t timeout) {
+    auto result = vkWaitForFences(*device, 1, &handle, true, timeout);
+    if (result == VK_TIMEOUT)
+        return false;
+    checkResult(result, "Failed waiting on fences");
+    return true;
+}
+
 void carbon::Fence::reset() {
     waitMutex.lock();
     auto result = vkResetFences(*device, 1, &handle);
     checkResult(result, "Failed to reset fences");
     waitMutex.unlock();
 }
+
+bool carbon::Fence::isSignaled() const { return vkGetFenceStatus(*device, handle) == VK_SUCCESS; }
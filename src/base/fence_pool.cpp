@@ -0,0 +1,94 @@
+#include <cassert>
+#include <utility>
+
+#include <fmt/core.h>
+
+#include <carbon/base/device.hpp>
+#include <carbon/base/fence.hpp>
+#include <carbon/base/fence_pool.hpp>
+#include <carbon/utils.hpp>
+
+carbon::FencePool::FencePool(std::shared_ptr<carbon::Device> device, std::string name) : device(std::move(device)), name(std::move(name)) {}
+
+carbon::FencePool::~FencePool() = default;
+
+void carbon::FencePool::createFence() {
+    auto fence = std::make_unique<carbon::Fence>(device, fmt::format("{}_fence{}", name, fences.size()));
+    fence->create();
+    freeFences.push_back(fence.get());
+    fences.push_back(std::move(fence));
+    ++statistics.createdFences;
+}
+
+void carbon::FencePool::resetReleasedFences() {
+    // Resetting a fence whose signal operation is still pending is invalid.
+    std::erase_if(retiredFences, [this](carbon::Fence* fence) {
+        if (!fence->isSignaled())
+            return false;
+        releasedFences.push_back(fence);
+        return true;
+    });
+    if (releasedFences.empty())
+        return;
+
+    resetHandles.clear();
+    for (auto* fence : releasedFences)
+        resetHandles.push_back(*fence);
+    auto result = vkResetFences(*device, static_cast<uint32_t>(resetHandles.size()), resetHandles.data());
+    checkResult(result, "Failed to reset pooled fences");
+
+    freeFences.insert(freeFences.end(), releasedFences.begin(), releasedFences.end());
+    releasedFences.clear();
+    ++statistics.resetBatches;
+}
+
+void carbon::FencePool::create(uint32_t initialCount) {
+    std::scoped_lock lock(mutex);
+    fences.reserve(initialCount);
+    for (uint32_t i = 0; i < initialCount; ++i)
+        createFence();
+}
+
+void carbon::FencePool::destroy() {
+    std::scoped_lock lock(mutex);
+    for (auto& fence : fences)
+        fence->destroy();
+    fences.clear();
+    freeFences.clear();
+    releasedFences.clear();
+    retiredFences.clear();
+}
+
+auto carbon::FencePool::acquire() -> carbon::Fence* {
+    std::scoped_lock lock(mutex);
+    // Only reset once we run out, so that as many fences as possible are reset at once.
+    if (freeFences.empty())
+        resetReleasedFences();
+    if (freeFences.empty())
+        createFence();
+
+    auto* fence = freeFences.back();
+    freeFences.pop_back();
+    ++statistics.acquiredFences;
+    return fence;
+}
+
+void carbon::FencePool::release(carbon::Fence* fence) {
+    assert(fence != nullptr);
+    std::scoped_lock lock(mutex);
+    releasedFences.push_back(fence);
+    ++statistics.releasedFences;
+}
+
+void carbon::FencePool::retire(carbon::Fence* fence, const carbon::Queue* queue, uint64_t value) {
+    device->retire(queue, value, [this, fence]() {
+        std::scoped_lock lock(mutex);
+        retiredFences.push_back(fence);
+        ++statistics.releasedFences;
+    });
+}
+
+auto carbon::FencePool::getStatistics() -> carbon::FencePoolStatistics {
+    std::scoped_lock lock(mutex);
+    return statistics;
+}
@@ -0,0 +1,199 @@
+#include <cassert>
+#include <utility>
+
+#include <fmt/core.h>
+
+#include <carbon/base/command_buffer.hpp>
+#include <carbon/base/command_pool_manager.hpp>
+#include <carbon/base/device.hpp>
+#include <carbon/base/fence.hpp>
+#include <carbon/base/frame_context.hpp>
+#include <carbon/base/queue.hpp>
+#include <carbon/base/semaphore.hpp>
+#include <carbon/base/swapchain.hpp>
+#include <carbon/resource/ringbuffer.hpp>
+#include <carbon/utils.hpp>
+
+carbon::FrameContext::FrameContext(std::shared_ptr<carbon::Device> device, VmaAllocator allocator, carbon::Swapchain* swapchain,
+                                   std::shared_ptr<carbon::Queue> queue, std::string name)
+    : device(std::move(device)), allocator(allocator), swapchain(swapchain), queue(std::move(queue)), name(std::move(name)) {}
+
+carbon::FrameContext::~FrameContext() = default;
+
+void carbon::FrameContext::create(VkSurfaceKHR newSurface, carbon::WindowExtentFunction windowExtent, uint32_t framesInFlight,
+                                  VkDeviceSize ringBufferSize, uint32_t threadCount) {
+    assert(framesInFlight > 0);
+    surface = newSurface;
+    windowExtentFunction = std::move(windowExtent);
+
+    poolManager = std::make_unique<carbon::CommandPoolManager>(device, fmt::format("{}_pools", name));
+    poolManager->create(queue->getFamilyIndex(), framesInFlight, threadCount);
+
+    slots.resize(framesInFlight);
+    for (uint32_t i = 0; i < framesInFlight; ++i) {
+        auto& slot = slots[i];
+        // The fences start signaled, so that the first use of every slot does not block.
+        slot.fence = std::make_unique<carbon::Fence>(device, fmt::format("{}_fence{}", name, i));
+        slot.fence->create(VK_FENCE_CREATE_SIGNALED_BIT);
+        slot.imageAvailable = std::make_shared<carbon::Semaphore>(device, fmt::format("{}_imageAvailable{}", name, i));
+        slot.imageAvailable->create();
+        slot.ringBuffer = std::make_unique<carbon::RingBuffer>(device.get(), allocator, fmt::format("{}_ring{}", name, i));
+        slot.ringBuffer->create(ringBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    }
+
+    createRenderFinishedSemaphores();
+}
+
+void carbon::FrameContext::destroy() {
+    for (auto& slot : slots)
+        slot.fence->wait(UINT64_MAX);
+    // The present operations are not covered by the fences.
+    queue->waitIdle();
+    device->flushRetired();
+
+    destroyRenderFinishedSemaphores();
+    for (auto& slot : slots) {
+        slot.ringBuffer->destroy();
+        slot.imageAvailable->destroy();
+        slot.fence->destroy();
+    }
+    slots.clear();
+
+    poolManager->destroy();
+    poolManager.reset();
+}
+
+void carbon::FrameContext::createRenderFinishedSemaphores() {
+    renderFinished.resize(swapchain->imageCount);
+    for (uint32_t i = 0; i < swapchain->imageCount; ++i) {
+        renderFinished[i] = std::make_shared<carbon::Semaphore>(device, fmt::format("{}_renderFinished{}", name, i));
+        renderFinished[i]->create();
+    }
+    imageFences.assign(swapchain->imageCount, nullptr);
+}
+
+void carbon::FrameContext::destroyRenderFinishedSemaphores() {
+    for (auto& semaphore : renderFinished)
+        semaphore->destroy();
+    renderFinished.clear();
+    imageFences.clear();
+}
+
+bool carbon::FrameContext::recreateSwapchain() {
+    const auto extent = windowExtentFunction();
+    if (extent.width == 0 || extent.height == 0)
+        return false;
+
+    // The old swapchain images and semaphores may still be used by frames in flight or by
+    // pending presents, which only an idle queue guarantees to be done with.
+    for (auto& slot : slots)
+        slot.fence->wait(UINT64_MAX);
+    queue->waitIdle();
+
+    destroyRenderFinishedSemaphores();
+    swapchain->create(surface, extent);
+    createRenderFinishedSemaphores();
+    needsRecreate = false;
+
+    if (recreateFunction)
+        recreateFunction(swapchain);
+    return true;
+}
+
+auto carbon::FrameContext::beginFrame() -> carbon::Frame* {
+    assert(!recording);
+    if (needsRecreate && !recreateSwapchain())
+        return nullptr;
+
+    const auto index = static_cast<uint32_t>(frameCount % slots.size());
+    auto& slot = slots[index];
+
+    // This only blocks if the CPU is framesInFlight frames ahead of the GPU.
+    slot.fence->wait(UINT64_MAX);
+
+    uint32_t imageIndex = 0;
+    auto result = swapchain->acquireNextImage(slot.imageAvailable, &imageIndex);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        // A failed acquire does not signal the semaphore, so it can be used again right away.
+        if (!recreateSwapchain())
+            return nullptr;
+        result = swapchain->acquireNextImage(slot.imageAvailable, &imageIndex);
+    }
+    if (result == VK_SUBOPTIMAL_KHR) {
+        // The image was acquired and the semaphore will be signaled, so we render this frame
+        // and recreate the swapchain afterwards.
+        needsRecreate = true;
+    } else {
+        checkResult(queue.get(), result, "Failed to acquire swapchain image");
+    }
+
+    // The acquired image might still be rendered to by an older frame using a different slot.
+    if (auto* imageFence = imageFences[imageIndex]; imageFence != nullptr && imageFence != slot.fence.get())
+        imageFence->wait(UINT64_MAX);
+    imageFences[imageIndex] = slot.fence.get();
+
+    // Only reset the fence once we are certain that this frame gets submitted.
+    slot.fence->reset();
+    poolManager->resetFrame(index);
+    slot.ringBuffer->beginFrame(slot.fence.get());
+    device->collectRetired();
+
+    currentFrame = {
+        .index = index,
+        .imageIndex = imageIndex,
+        .image = swapchain->swapchainImages[imageIndex].get(),
+        .cmdBuffer = poolManager->getCommandBuffer(index, 0),
+        .ringBuffer = slot.ringBuffer.get(),
+    };
+    currentFrame.cmdBuffer->begin();
+    recording = true;
+    return &currentFrame;
+}
+
+auto carbon::FrameContext::endFrame() -> uint64_t {
+    assert(recording);
+    auto& slot = slots[currentFrame.index];
+    auto& presentSemaphore = renderFinished[currentFrame.imageIndex];
+
+    currentFrame.cmdBuffer->end(queue.get());
+
+    const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    const VkCommandBuffer cmdBuffer = *currentFrame.cmdBuffer;
+    const VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &slot.imageAvailable->getHandle(),
+        .pWaitDstStageMask = &waitStage,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &cmdBuffer,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &presentSemaphore->getHandle(),
+    };
+    lastSubmittedValue = queue->submit(&submitInfo, slot.fence.get());
+    recording = false;
+    ++frameCount;
+
+    VkResult result;
+    {
+        auto lock = queue->getLock();
+        result = swapchain->queuePresent(queue, currentFrame.imageIndex, presentSemaphore);
+    }
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+        // Recreating is deferred to the next beginFrame, so that the window extent can settle.
+        needsRecreate = true;
+    } else {
+        checkResult(queue.get(), result, "Failed to present swapchain image");
+    }
+    return lastSubmittedValue;
+}
+
+void carbon::FrameContext::setRecreateCallback(carbon::SwapchainRecreateFunction callback) { recreateFunction = std::move(callback); }
+
+auto carbon::FrameContext::getCommandPoolManager() const -> carbon::CommandPoolManager* { return poolManager.get(); }
+
+auto carbon::FrameContext::getFrameCount() const -> uint64_t { return frameCount; }
+
+auto carbon::FrameContext::getFramesInFlight() const -> uint32_t { return static_cast<uint32_t>(slots.size()); }
+
+auto carbon::FrameContext::getLastSubmittedValue() const -> uint64_t { return lastSubmittedValue; }
@@ -0,0 +1,134 @@
+#include <algorithm>
+
+#include <carbon/base/memory_budget.hpp>
+#include <carbon/utils.hpp>
+
+carbon::MemoryBudget::MemoryBudget(VmaAllocator allocator) : allocator(allocator) {
+    vmaGetMemoryProperties(allocator, &memoryProperties);
+    heaps.resize(memoryProperties->memoryHeapCount);
+    for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; ++i) {
+        heaps[i].flags = memoryProperties->memoryHeaps[i].flags;
+        heaps[i].heapSize = memoryProperties->memoryHeaps[i].size;
+    }
+}
+
+void carbon::MemoryBudget::update(uint32_t frameIndex) {
+    vmaSetCurrentFrameIndex(allocator, frameIndex);
+
+    std::vector<uint32_t> overBudgetHeaps;
+    {
+        std::scoped_lock lock(budgetMutex);
+        VmaBudget budgets[VK_MAX_MEMORY_HEAPS] = {};
+        vmaGetHeapBudgets(allocator, budgets);
+        for (uint32_t i = 0; i < heaps.size(); ++i) {
+            heaps[i].usage = budgets[i].usage;
+            heaps[i].budget = budgets[i].budget;
+            heaps[i].blockBytes = budgets[i].statistics.blockBytes;
+            heaps[i].allocationBytes = budgets[i].statistics.allocationBytes;
+            if (heaps[i].usage > heaps[i].budget)
+                overBudgetHeaps.push_back(i);
+        }
+    }
+
+    for (auto heapIndex : overBudgetHeaps)
+        ensureAvailable(heapIndex, 0);
+}
+
+auto carbon::MemoryBudget::getHeapCount() const -> uint32_t { return memoryProperties->memoryHeapCount; }
+
+auto carbon::MemoryBudget::getHeapBudget(uint32_t heapIndex) const -> carbon::HeapBudget {
+    std::scoped_lock lock(budgetMutex);
+    return heaps[heapIndex];
+}
+
+auto carbon::MemoryBudget::getHeapIndex(VkMemoryPropertyFlags properties) const -> uint32_t {
+    for (uint32_t i = 0; i < memoryProperties->memoryTypeCount; ++i) {
+        if (isFlagSet(memoryProperties->memoryTypes[i].propertyFlags, properties))
+            return memoryProperties->memoryTypes[i].heapIndex;
+    }
+    return VK_MAX_MEMORY_HEAPS;
+}
+
+auto carbon::MemoryBudget::getAttributedUsage() const -> std::map<std::string, VkDeviceSize> {
+    std::scoped_lock lock(budgetMutex);
+    return attributedUsage;
+}
+
+void carbon::MemoryBudget::trackAllocation(VmaAllocation allocation, const std::string& name) {
+    if (allocation == nullptr)
+        return;
+
+    VmaAllocationInfo allocationInfo = {};
+    vmaGetAllocationInfo(allocator, allocation, &allocationInfo);
+
+    std::scoped_lock lock(budgetMutex);
+    allocations[allocation] = {
+        .name = name,
+        .size = allocationInfo.size,
+        .heapIndex = memoryProperties->memoryTypes[allocationInfo.memoryType].heapIndex,
+    };
+    attributedUsage[name] += allocationInfo.size;
+}
+
+void carbon::MemoryBudget::untrackAllocation(VmaAllocation allocation) {
+    std::scoped_lock lock(budgetMutex);
+    auto tracked = allocations.find(allocation);
+    if (tracked == allocations.end())
+        return;
+
+    auto usage = attributedUsage.find(tracked->second.name);
+    if (usage != attributedUsage.end()) {
+        usage->second -= std::min(usage->second, tracked->second.size);
+        if (usage->second == 0)
+            attributedUsage.erase(usage);
+    }
+    allocations.erase(tracked);
+}
+
+auto carbon::MemoryBudget::registerEvictable(std::string name, uint32_t priority, carbon::EvictionCallback callback, uint32_t heapIndex)
+    -> uint64_t {
+    std::scoped_lock lock(budgetMutex);
+    auto id = nextEvictableId++;
+    evictables.push_back({
+        .id = id,
+        .name = std::move(name),
+        .priority = priority,
+        .heapIndex = heapIndex,
+        .callback = std::move(callback),
+    });
+    return id;
+}
+
+void carbon::MemoryBudget::unregisterEvictable(uint64_t id) {
+    std::scoped_lock lock(budgetMutex);
+    std::erase_if(evictables, [id](const Evictable& evictable) { return evictable.id == id; });
+}
+
+bool carbon::MemoryBudget::ensureAvailable(uint32_t heapIndex, VkDeviceSize bytes) {
+    VkDeviceSize missing = 0;
+    std::vector<Evictable> candidates;
+    {
+        std::scoped_lock lock(budgetMutex);
+        VmaBudget budgets[VK_MAX_MEMORY_HEAPS] = {};
+        vmaGetHeapBudgets(allocator, budgets);
+        const auto required = budgets[heapIndex].usage + bytes;
+        if (required <= budgets[heapIndex].budget)
+            return true;
+        missing = required - budgets[heapIndex].budget;
+
+        for (const auto& evictable : evictables) {
+            if (evictable.heapIndex == heapIndex || evictable.heapIndex == VK_MAX_MEMORY_HEAPS)
+                candidates.push_back(evictable);
+        }
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(), [](const Evictable& a, const Evictable& b) { return a.priority < b.priority; });
+
+    VkDeviceSize freed = 0;
+    for (auto& candidate : candidates) {
+        if (freed >= missing)
+            break;
+        freed += candidate.callback();
+    }
+    return freed >= missing;
+}
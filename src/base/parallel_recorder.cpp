@@ -0,0 +1,50 @@
+#include <algorithm>
+#include <future>
+
+#include <carbon/base/command_buffer.hpp>
+#include <carbon/base/command_pool_manager.hpp>
+#include <carbon/base/parallel_recorder.hpp>
+#include <carbon/base/thread_pool.hpp>
+
+carbon::ParallelRecorder::ParallelRecorder(carbon::ThreadPool* threadPool, carbon::CommandPoolManager* poolManager)
+    : threadPool(threadPool), poolManager(poolManager) {}
+
+void carbon::ParallelRecorder::record(carbon::CommandBuffer* primary, uint32_t frameIndex,
+                                      const VkCommandBufferInheritanceRenderingInfo& renderingInfo, size_t drawCount,
+                                      const carbon::RecordFunction& recordFunction, uint32_t threadCount) {
+    if (drawCount == 0)
+        return;
+
+    if (threadCount == 0)
+        threadCount = poolManager->getThreadCount();
+    threadCount = std::min(threadCount, poolManager->getThreadCount());
+    const auto rangeCount = std::max<size_t>(1, std::min<size_t>(threadCount, (drawCount + minDrawsPerThread - 1) / minDrawsPerThread));
+    const auto rangeSize = (drawCount + rangeCount - 1) / rangeCount;
+
+    std::vector<std::future<carbon::CommandBuffer*>> futures;
+    futures.reserve(rangeCount);
+    for (uint32_t i = 0; i < rangeCount; ++i) {
+        const auto begin = i * rangeSize;
+        const auto end = std::min(drawCount, begin + rangeSize);
+        futures.push_back(threadPool->submit([this, i, begin, end, frameIndex, &renderingInfo, &recordFunction]() {
+            auto* cmdBuffer = poolManager->getCommandBuffer(frameIndex, i, VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+                                                            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+            cmdBuffer->beginSecondary(&renderingInfo);
+            recordFunction(cmdBuffer, begin, end);
+            cmdBuffer->end(nullptr);
+            return cmdBuffer;
+        }));
+    }
+
+    // Every task references our arguments, so we have to wait for all of them before a
+    // potential exception of one worker gets rethrown by get().
+    for (auto& future : futures)
+        future.wait();
+
+    // The secondary buffers are executed in the order of their ranges, regardless of
+    // which thread finished first.
+    secondaryHandles.clear();
+    for (auto& future : futures)
+        secondaryHandles.push_back(*future.get());
+    primary->executeCommands(secondaryHandles);
+}
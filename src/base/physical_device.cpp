@@ -17,21 +17,40 @@ void carbon::PhysicalDevice::create(carbon::Instance* instance, VkSurfaceKHR sur
         physicalDeviceSelector.add_required_extension(ext);
 
     physicalDeviceSelector.add_desired_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    // Lets GPU culling decide how many indirect draws are executed.
+    physicalDeviceSelector.add_desired_extension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
     // physicalDeviceSelector.add_desired_extension(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
 
     // Should conditionally add these feature, but heck, who's going to use this besides me.
     {
         VkPhysicalDeviceFeatures deviceFeatures = {
+            .multiDrawIndirect = true,
+            .drawIndirectFirstInstance = true,
             .shaderInt64 = true,
         };
         physicalDeviceSelector.set_required_features(deviceFeatures);
 
+        // Every queue tracks its submissions with a timeline semaphore. This is core in Vulkan
+        // 1.2. Neither this nor synchronization2 below may also be requested through the
+        // Vulkan12Features or Vulkan13Features structures.
+        VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+            .timelineSemaphore = true,
+        };
+        physicalDeviceSelector.add_required_extension_features(timelineSemaphoreFeatures);
+
+        // Used for batched submissions. This is core in Vulkan 1.3.
+        VkPhysicalDeviceSynchronization2Features synchronization2Features = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES,
+            .synchronization2 = true,
+        };
+        physicalDeviceSelector.add_required_extension_features(synchronization2Features);
+
         /*VkPhysicalDeviceVulkan12Features vulkan12Features = {
             .descriptorIndexing = true,
             .shaderSampledImageArrayNonUniformIndexing = true,
             .runtimeDescriptorArray = true,
             .scalarBlockLayout = true,
-            .timelineSemaphore = true,
             .bufferDeviceAddress = true,
         };
         physicalDeviceSelector.set_required_features_12(vulkan12Features);
@@ -85,9 +104,23 @@ VkPhysicalDeviceProperties2 carbon::PhysicalDevice::getProperties(void* const pN
 }
 
 VkPhysicalDeviceMemoryProperties2* carbon::PhysicalDevice::getMemoryProperties(void* const pNext) const {
+    // The memory types and heaps never change, but chained structures like
+    // VkPhysicalDeviceMemoryBudgetPropertiesEXT have to be queried every time.
+    if (pNext != nullptr) {
+        VkPhysicalDeviceMemoryProperties2 properties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+            .pNext = pNext,
+        };
+        vkGetPhysicalDeviceMemoryProperties2(handle.physical_device, &properties);
+    }
     return memoryProperties.get();
 }
 
+VkQueueFlags carbon::PhysicalDevice::getQueueFamilyFlags(uint32_t queueFamilyIndex) const {
+    auto queueFamilies = handle.get_queue_families();
+    return queueFamilyIndex < queueFamilies.size() ? queueFamilies[queueFamilyIndex].queueFlags : 0;
+}
+
 bool carbon::PhysicalDevice::supportsExtension(const char* extension) {
     auto extensions = handle.get_extensions();
     for (const auto& ext : extensions) {
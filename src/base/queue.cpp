@@ -1,21 +1,39 @@
+#include <tuple>
 #include <utility>
 
 #include <carbon/base/device.hpp>
 #include <carbon/base/fence.hpp>
 #include <carbon/base/queue.hpp>
 #include <carbon/base/semaphore.hpp>
+#include <carbon/base/timeline_semaphore.hpp>
+#include <carbon/utils.hpp>
 
-carbon::Queue::Queue(std::shared_ptr<carbon::Device> device, std::string name) : device(std::move(device)), name(std::move(name)) {}
+carbon::Queue::Queue(std::shared_ptr<carbon::Device> device, std::string name)
+    : device(std::move(device)), name(std::move(name)), queueMutex(std::make_shared<std::mutex>()),
+      lastSubmittedValue(std::make_shared<uint64_t>(0)) {}
 
-carbon::Queue::Queue(const carbon::Queue& queue) : name(queue.name), handle(queue.handle) {}
+carbon::Queue::Queue(const carbon::Queue& queue)
+    : device(queue.device), name(queue.name), handle(queue.handle), familyIndex(queue.familyIndex), queueMutex(queue.queueMutex),
+      timeline(queue.timeline), lastSubmittedValue(queue.lastSubmittedValue) {}
 
 carbon::Queue::operator VkQueue() const { return this->handle; }
 
 void carbon::Queue::create(const vkb::QueueType queueType) {
-    handle = device->getQueue(queueType);
+    std::tie(handle, familyIndex) = device->findQueue(queueType);
+    queueMutex = device->getQueueMutex(handle);
 
     if (!name.empty())
         device->setDebugUtilsName(handle, name);
+
+    // A new timeline starts counting from zero again, without affecting copies of the old one.
+    lastSubmittedValue = std::make_shared<uint64_t>(0);
+    timeline = std::make_shared<carbon::TimelineSemaphore>(device, name.empty() ? std::string {} : name + "_timeline");
+    timeline->create(*lastSubmittedValue);
+}
+
+void carbon::Queue::destroy() const {
+    if (timeline != nullptr)
+        timeline->destroy();
 }
 
 std::vector<VkCheckpointDataNV> carbon::Queue::getCheckpointData(uint32_t queryCount) const {
@@ -34,9 +52,22 @@ std::vector<VkCheckpointDataNV> carbon::Queue::getCheckpointData(uint32_t queryC
 #endif // #ifdef WITH_NV_AFTERMATH
 }
 
-void carbon::Queue::lock() const { queueMutex.lock(); }
+uint64_t carbon::Queue::getCompletedValue() const { return timeline->getCompletedValue(); }
+
+uint32_t carbon::Queue::getFamilyIndex() const { return familyIndex; }
+
+uint64_t carbon::Queue::getLastSubmittedValue() const {
+    std::scoped_lock lock(*queueMutex);
+    return *lastSubmittedValue;
+}
+
+carbon::TimelineSemaphore* carbon::Queue::getTimelineSemaphore() const { return timeline.get(); }
+
+bool carbon::Queue::isComplete(uint64_t value) const { return timeline->isComplete(value); }
 
-void carbon::Queue::unlock() const { queueMutex.unlock(); }
+void carbon::Queue::lock() const { queueMutex->lock(); }
+
+void carbon::Queue::unlock() const { queueMutex->unlock(); }
 
 void carbon::Queue::waitIdle() const {
     if (handle != nullptr)
@@ -44,13 +75,60 @@ void carbon::Queue::waitIdle() const {
 }
 
 std::unique_lock<std::mutex> carbon::Queue::getLock() const {
-    return std::unique_lock(queueMutex); // Auto locks.
+    return std::unique_lock(*queueMutex); // Auto locks.
 }
 
 VkResult carbon::Queue::submit(carbon::Fence* fence, const VkSubmitInfo* submitInfo) const {
     return vkQueueSubmit(handle, 1, submitInfo, *fence);
 }
 
+uint64_t carbon::Queue::submit(const VkSubmitInfo* submitInfo, carbon::Fence* fence, const std::vector<carbon::TimelineWait>& waits) {
+    // The values of binary semaphores are ignored, but the value arrays have to match the
+    // semaphore arrays in length.
+    std::vector<VkSemaphore> waitSemaphores(submitInfo->pWaitSemaphores, submitInfo->pWaitSemaphores + submitInfo->waitSemaphoreCount);
+    std::vector<VkPipelineStageFlags> waitStages(submitInfo->pWaitDstStageMask,
+                                                 submitInfo->pWaitDstStageMask + submitInfo->waitSemaphoreCount);
+    std::vector<uint64_t> waitValues(waitSemaphores.size(), 0);
+    for (const auto& wait : waits) {
+        waitSemaphores.push_back(*wait.queue->timeline);
+        waitStages.push_back(wait.stageMask);
+        waitValues.push_back(wait.value);
+    }
+
+    std::vector<VkSemaphore> signalSemaphores(submitInfo->pSignalSemaphores,
+                                              submitInfo->pSignalSemaphores + submitInfo->signalSemaphoreCount);
+    signalSemaphores.push_back(*timeline);
+    std::vector<uint64_t> signalValues(signalSemaphores.size(), 0);
+
+    auto lock = getLock();
+    const auto value = *lastSubmittedValue + 1;
+    signalValues.back() = value;
+
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = submitInfo->pNext,
+        .waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size()),
+        .pWaitSemaphoreValues = waitValues.data(),
+        .signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size()),
+        .pSignalSemaphoreValues = signalValues.data(),
+    };
+    VkSubmitInfo trackedSubmitInfo = *submitInfo;
+    trackedSubmitInfo.pNext = &timelineSubmitInfo;
+    trackedSubmitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    trackedSubmitInfo.pWaitSemaphores = waitSemaphores.data();
+    trackedSubmitInfo.pWaitDstStageMask = waitStages.data();
+    trackedSubmitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+    trackedSubmitInfo.pSignalSemaphores = signalSemaphores.data();
+
+    auto result = vkQueueSubmit(handle, 1, &trackedSubmitInfo, fence != nullptr ? VkFence(*fence) : VK_NULL_HANDLE);
+    checkResult(this, result, "Failed to submit to queue");
+
+    *lastSubmittedValue = value;
+    return value;
+}
+
+bool carbon::Queue::wait(uint64_t value, uint64_t timeout) const { return timeline->wait(value, timeout); }
+
 VkResult carbon::Queue::present(uint32_t imageIndex, const VkSwapchainKHR& swapchain,
                                 std::shared_ptr<carbon::Semaphore> waitSemaphore) const {
     VkPresentInfoKHR presentInfo = {
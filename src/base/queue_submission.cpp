@@ -0,0 +1,108 @@
+#include <carbon/base/command_buffer.hpp>
+#include <carbon/base/device.hpp>
+#include <carbon/base/fence.hpp>
+#include <carbon/base/queue.hpp>
+#include <carbon/base/queue_submission.hpp>
+#include <carbon/base/semaphore.hpp>
+#include <carbon/base/timeline_semaphore.hpp>
+#include <carbon/utils.hpp>
+
+carbon::QueueSubmission::QueueSubmission(carbon::Queue* queue) : queue(queue) {}
+
+auto carbon::QueueSubmission::addCommandBuffer(const carbon::CommandBuffer* cmdBuffer) -> carbon::QueueSubmission& {
+    return addCommandBuffer(VkCommandBuffer(*cmdBuffer));
+}
+
+auto carbon::QueueSubmission::addCommandBuffer(VkCommandBuffer cmdBuffer) -> carbon::QueueSubmission& {
+    batches.back().cmdBufferInfos.push_back({
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+        .commandBuffer = cmdBuffer,
+    });
+    return *this;
+}
+
+auto carbon::QueueSubmission::nextBatch() -> carbon::QueueSubmission& {
+    const auto& last = batches.back();
+    if (!last.waitInfos.empty() || !last.cmdBufferInfos.empty() || !last.signalInfos.empty())
+        batches.emplace_back();
+    return *this;
+}
+
+auto carbon::QueueSubmission::signal(const carbon::Semaphore& semaphore, VkPipelineStageFlags2 stageMask) -> carbon::QueueSubmission& {
+    batches.back().signalInfos.push_back({
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = semaphore,
+        .stageMask = stageMask,
+    });
+    return *this;
+}
+
+auto carbon::QueueSubmission::signal(const carbon::TimelineSemaphore& semaphore, uint64_t value, VkPipelineStageFlags2 stageMask)
+    -> carbon::QueueSubmission& {
+    batches.back().signalInfos.push_back({
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = semaphore,
+        .value = value,
+        .stageMask = stageMask,
+    });
+    return *this;
+}
+
+auto carbon::QueueSubmission::wait(const carbon::Semaphore& semaphore, VkPipelineStageFlags2 stageMask) -> carbon::QueueSubmission& {
+    batches.back().waitInfos.push_back({
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = semaphore,
+        .stageMask = stageMask,
+    });
+    return *this;
+}
+
+auto carbon::QueueSubmission::wait(const carbon::TimelineSemaphore& semaphore, uint64_t value, VkPipelineStageFlags2 stageMask)
+    -> carbon::QueueSubmission& {
+    batches.back().waitInfos.push_back({
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = semaphore,
+        .value = value,
+        .stageMask = stageMask,
+    });
+    return *this;
+}
+
+auto carbon::QueueSubmission::wait(const carbon::TimelineWait& timelineWait) -> carbon::QueueSubmission& {
+    // The legacy stage bits are identical to the lower bits of the synchronization2 stages.
+    const auto stageMask = static_cast<VkPipelineStageFlags2>(timelineWait.stageMask);
+    return wait(*timelineWait.queue->getTimelineSemaphore(), timelineWait.value, stageMask);
+}
+
+auto carbon::QueueSubmission::submit(carbon::Fence* fence) -> uint64_t {
+    std::vector<VkSubmitInfo2> submitInfos;
+    submitInfos.reserve(batches.size());
+
+    auto lock = queue->getLock();
+    const auto value = *queue->lastSubmittedValue + 1;
+    // Signal operations cover every command earlier in submission order, so signaling the
+    // timeline in the last batch covers all batches.
+    signal(*queue->timeline, value);
+
+    for (const auto& batch : batches) {
+        if (batch.waitInfos.empty() && batch.cmdBufferInfos.empty() && batch.signalInfos.empty())
+            continue;
+        submitInfos.push_back({
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+            .waitSemaphoreInfoCount = static_cast<uint32_t>(batch.waitInfos.size()),
+            .pWaitSemaphoreInfos = batch.waitInfos.data(),
+            .commandBufferInfoCount = static_cast<uint32_t>(batch.cmdBufferInfos.size()),
+            .pCommandBufferInfos = batch.cmdBufferInfos.data(),
+            .signalSemaphoreInfoCount = static_cast<uint32_t>(batch.signalInfos.size()),
+            .pSignalSemaphoreInfos = batch.signalInfos.data(),
+        });
+    }
+
+    auto result = queue->device->vkQueueSubmit2(*queue, static_cast<uint32_t>(submitInfos.size()), submitInfos.data(),
+                                                fence != nullptr ? VkFence(*fence) : VK_NULL_HANDLE);
+    batches = { {} };
+    checkResult(queue, result, "Failed to submit to queue");
+
+    *queue->lastSubmittedValue = value;
+    return value;
+}
@@ -0,0 +1,91 @@
+#include <carbon/base/resource_usage.hpp>
+
+namespace {
+    // Stages which can access descriptors. Compute and ray tracing are included, as a usage
+    // does not know which pipeline is going to access it. Command buffers remove the stages
+    // their queue does not support, see maskResourceUsageInfo.
+    constexpr VkPipelineStageFlags2 shaderStages = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT |
+                                                   VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR;
+
+    // Stages and accesses which are available on every queue, including transfer only queues.
+    constexpr VkPipelineStageFlags2 transferStages = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT |
+                                                     VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT | VK_PIPELINE_STAGE_2_HOST_BIT |
+                                                     VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT | VK_PIPELINE_STAGE_2_COPY_BIT |
+                                                     VK_PIPELINE_STAGE_2_RESOLVE_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT |
+                                                     VK_PIPELINE_STAGE_2_CLEAR_BIT;
+    constexpr VkAccessFlags2 transferAccesses = VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_READ_BIT |
+                                                VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+    // Stages and accesses which are only available on queues supporting compute.
+    constexpr VkPipelineStageFlags2 computeStages = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+                                                    VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR |
+                                                    VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR;
+    constexpr VkAccessFlags2 computeAccesses = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_UNIFORM_READ_BIT |
+                                               VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT |
+                                               VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+                                               VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR |
+                                               VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+} // namespace
+
+auto carbon::getResourceUsageInfo(carbon::ResourceUsage usage) -> carbon::ResourceUsageInfo {
+    switch (usage) {
+        default:
+        case carbon::ResourceUsage::Undefined: return {};
+        case carbon::ResourceUsage::IndexBuffer:
+            return { VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+        case carbon::ResourceUsage::VertexBuffer:
+            return { VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+        case carbon::ResourceUsage::IndirectBuffer:
+            return { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+        case carbon::ResourceUsage::UniformBuffer: return { shaderStages, VK_ACCESS_2_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+        case carbon::ResourceUsage::SampledRead:
+            return { shaderStages, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        case carbon::ResourceUsage::StorageRead: return { shaderStages, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL };
+        case carbon::ResourceUsage::StorageWrite: return { shaderStages, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+        case carbon::ResourceUsage::StorageReadWrite:
+            return { shaderStages, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+        case carbon::ResourceUsage::ColorAttachment:
+            return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                     VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                     VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+        case carbon::ResourceUsage::DepthStencilAttachment:
+            return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                     VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                     VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+        case carbon::ResourceUsage::DepthStencilRead:
+            return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT | shaderStages,
+                     VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                     VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+        case carbon::ResourceUsage::TransferSrc:
+            return { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+        case carbon::ResourceUsage::TransferDst:
+            return { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+        case carbon::ResourceUsage::AccelerationStructureBuildInput:
+            return { VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+        case carbon::ResourceUsage::AccelerationStructureBuild:
+            return { VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                     VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+                     VK_IMAGE_LAYOUT_UNDEFINED };
+        case carbon::ResourceUsage::AccelerationStructureRead:
+            return { shaderStages, VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR, VK_IMAGE_LAYOUT_UNDEFINED };
+        case carbon::ResourceUsage::HostRead: return { VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT, VK_IMAGE_LAYOUT_GENERAL };
+        case carbon::ResourceUsage::HostWrite: return { VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+        case carbon::ResourceUsage::Present:
+            // Presentation is synchronized with semaphores, so no stage or access is needed.
+            return { VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+    }
+}
+
+auto carbon::getSupportedUsage(VkQueueFlags queueFlags) -> carbon::SupportedUsage {
+    // Graphics queues support every stage, including the ones of extensions.
+    if ((queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0)
+        return {};
+    if ((queueFlags & VK_QUEUE_COMPUTE_BIT) != 0)
+        return { transferStages | computeStages, transferAccesses | computeAccesses };
+    return { transferStages, transferAccesses };
+}
+
+auto carbon::maskResourceUsageInfo(const carbon::ResourceUsageInfo& info, const carbon::SupportedUsage& supported)
+    -> carbon::ResourceUsageInfo {
+    return { info.stageMask & supported.stageMask, info.accessMask & supported.accessMask, info.imageLayout };
+}
@@ -0,0 +1,63 @@
+#include <cassert>
+#include <utility>
+
+#include <fmt/core.h>
+
+#include <carbon/base/device.hpp>
+#include <carbon/base/semaphore.hpp>
+#include <carbon/base/semaphore_pool.hpp>
+
+carbon::SemaphorePool::SemaphorePool(std::shared_ptr<carbon::Device> device, std::string name)
+    : device(std::move(device)), name(std::move(name)) {}
+
+carbon::SemaphorePool::~SemaphorePool() = default;
+
+void carbon::SemaphorePool::createSemaphore() {
+    auto semaphore = std::make_shared<carbon::Semaphore>(device, fmt::format("{}_semaphore{}", name, semaphores.size()));
+    semaphore->create();
+    freeSemaphores.push_back(semaphore);
+    semaphores.push_back(std::move(semaphore));
+    ++statistics.createdSemaphores;
+}
+
+void carbon::SemaphorePool::create(uint32_t initialCount) {
+    std::scoped_lock lock(mutex);
+    semaphores.reserve(initialCount);
+    for (uint32_t i = 0; i < initialCount; ++i)
+        createSemaphore();
+}
+
+void carbon::SemaphorePool::destroy() {
+    std::scoped_lock lock(mutex);
+    for (auto& semaphore : semaphores)
+        semaphore->destroy();
+    semaphores.clear();
+    freeSemaphores.clear();
+}
+
+auto carbon::SemaphorePool::acquire() -> std::shared_ptr<carbon::Semaphore> {
+    std::scoped_lock lock(mutex);
+    if (freeSemaphores.empty())
+        createSemaphore();
+
+    auto semaphore = std::move(freeSemaphores.back());
+    freeSemaphores.pop_back();
+    ++statistics.acquiredSemaphores;
+    return semaphore;
+}
+
+void carbon::SemaphorePool::release(std::shared_ptr<carbon::Semaphore> semaphore) {
+    assert(semaphore != nullptr);
+    std::scoped_lock lock(mutex);
+    freeSemaphores.push_back(std::move(semaphore));
+    ++statistics.releasedSemaphores;
+}
+
+void carbon::SemaphorePool::retire(std::shared_ptr<carbon::Semaphore> semaphore, const carbon::Queue* queue, uint64_t value) {
+    device->retire(queue, value, [this, semaphore = std::move(semaphore)]() mutable { release(std::move(semaphore)); });
+}
+
+auto carbon::SemaphorePool::getStatistics() -> carbon::SemaphorePoolStatistics {
+    std::scoped_lock lock(mutex);
+    return statistics;
+}
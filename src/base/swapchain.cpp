@@ -85,12 +85,16 @@ bool carbon::Swapchain::create(VkSurfaceKHR surface, VkExtent2D windowExtent) {
     VkSwapchainKHR newSwapchain = nullptr;
     auto res = device->vkCreateSwapchainKHR(*device, &createInfo, nullptr, &newSwapchain);
     checkResult(res, "Failed to create swapchain");
-    swapchain = newSwapchain;
 
-    // First, destroy the previous swapchain image views
+    // First, destroy the previous swapchain image views, which have to go before their images.
     for (auto& image : swapchainImages)
         image->destroy();
 
+    // The old swapchain is retired by passing it as oldSwapchain, but still has to be destroyed.
+    if (swapchain != nullptr)
+        vkDestroySwapchainKHR(*device, swapchain, nullptr);
+    swapchain = newSwapchain;
+
     // Get the swapchain images
     device->vkGetSwapchainImagesKHR(*device, swapchain, &imageCount, nullptr);
     std::vector<VkImage> vulkanImages(imageCount);
@@ -0,0 +1,42 @@
+#include <carbon/base/thread_pool.hpp>
+
+carbon::ThreadPool::ThreadPool(uint32_t threadCount) {
+    workers.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++i)
+        workers.emplace_back(&carbon::ThreadPool::work, this);
+}
+
+carbon::ThreadPool::~ThreadPool() {
+    {
+        std::scoped_lock lock(taskMutex);
+        stopping = true;
+    }
+    taskCondition.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void carbon::ThreadPool::work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(taskMutex);
+            taskCondition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty())
+                return; // Only happens when stopping.
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+void carbon::ThreadPool::enqueue(std::function<void()> task) {
+    {
+        std::scoped_lock lock(taskMutex);
+        tasks.push(std::move(task));
+    }
+    taskCondition.notify_one();
+}
+
+auto carbon::ThreadPool::getThreadCount() const -> uint32_t { return static_cast<uint32_t>(workers.size()); }
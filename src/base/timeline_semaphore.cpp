@@ -0,0 +1,68 @@
+#include <utility>
+
+#include <carbon/base/device.hpp>
+#include <carbon/base/timeline_semaphore.hpp>
+#include <carbon/utils.hpp>
+
+carbon::TimelineSemaphore::TimelineSemaphore(std::shared_ptr<carbon::Device> device, std::string name)
+    : device(std::move(device)), name(std::move(name)) {}
+
+carbon::TimelineSemaphore::operator VkSemaphore() const { return handle; }
+
+void carbon::TimelineSemaphore::create(uint64_t initialValue) {
+    VkSemaphoreTypeCreateInfo typeCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = initialValue,
+    };
+    VkSemaphoreCreateInfo semaphoreCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &typeCreateInfo,
+    };
+    auto result = vkCreateSemaphore(*device, &semaphoreCreateInfo, nullptr, &handle);
+    checkResult(result, "Failed to create timeline semaphore");
+
+    if (!name.empty())
+        device->setDebugUtilsName(handle, name);
+}
+
+void carbon::TimelineSemaphore::destroy() const {
+    if (handle != nullptr)
+        vkDestroySemaphore(*device, handle, nullptr);
+}
+
+auto carbon::TimelineSemaphore::getCompletedValue() const -> uint64_t {
+    uint64_t value = 0;
+    auto result = vkGetSemaphoreCounterValue(*device, handle, &value);
+    checkResult(result, "Failed to get timeline semaphore value");
+    return value;
+}
+
+auto carbon::TimelineSemaphore::getHandle() const -> const VkSemaphore& { return handle; }
+
+bool carbon::TimelineSemaphore::isComplete(uint64_t value) const { return getCompletedValue() >= value; }
+
+void carbon::TimelineSemaphore::signal(uint64_t value) const {
+    VkSemaphoreSignalInfo signalInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO,
+        .semaphore = handle,
+        .value = value,
+    };
+    auto result = vkSignalSemaphore(*device, &signalInfo);
+    checkResult(result, "Failed to signal timeline semaphore");
+}
+
+bool carbon::TimelineSemaphore::wait(uint64_t value, uint64_t timeout) const {
+    VkSemaphoreWaitInfo waitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &handle,
+        .pValues = &value,
+    };
+    // Waiting on semaphores is thread safe, and unlike fences nothing has to be reset afterwards.
+    auto result = vkWaitSemaphores(*device, &waitInfo, timeout);
+    if (result == VK_TIMEOUT)
+        return false;
+    checkResult(result, "Failed waiting on timeline semaphore");
+    return true;
+}
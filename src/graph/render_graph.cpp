@@ -0,0 +1,491 @@
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include <fmt/core.h>
+
+#include <carbon/base/command_buffer.hpp>
+#include <carbon/base/device.hpp>
+#include <carbon/base/memory_budget.hpp>
+#include <carbon/graph/render_graph.hpp>
+#include <carbon/resource/buffer.hpp>
+#include <carbon/resource/image.hpp>
+#include <carbon/utils.hpp>
+
+namespace {
+    auto getAspectMask(VkFormat format) -> VkImageAspectFlags {
+        switch (format) {
+            case VK_FORMAT_D16_UNORM:
+            case VK_FORMAT_X8_D24_UNORM_PACK32:
+            case VK_FORMAT_D32_SFLOAT: return VK_IMAGE_ASPECT_DEPTH_BIT;
+            case VK_FORMAT_S8_UINT: return VK_IMAGE_ASPECT_STENCIL_BIT;
+            case VK_FORMAT_D16_UNORM_S8_UINT:
+            case VK_FORMAT_D24_UNORM_S8_UINT:
+            case VK_FORMAT_D32_SFLOAT_S8_UINT: return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+            default: return VK_IMAGE_ASPECT_COLOR_BIT;
+        }
+    }
+
+    bool lifetimesOverlap(uint32_t firstA, uint32_t lastA, uint32_t firstB, uint32_t lastB) { return firstA <= lastB && firstB <= lastA; }
+} // namespace
+
+carbon::GraphPass::GraphPass(std::string name, carbon::GraphExecuteFunction execute) : name(std::move(name)), execute(std::move(execute)) {}
+
+auto carbon::GraphPass::read(carbon::GraphResource resource, carbon::ResourceUsage usage) -> carbon::GraphPass& {
+    accesses.push_back({ resource, usage, false });
+    return *this;
+}
+
+auto carbon::GraphPass::write(carbon::GraphResource resource, carbon::ResourceUsage usage) -> carbon::GraphPass& {
+    accesses.push_back({ resource, usage, true });
+    return *this;
+}
+
+auto carbon::GraphPass::setSideEffects() -> carbon::GraphPass& {
+    sideEffects = true;
+    return *this;
+}
+
+carbon::RenderGraph::RenderGraph(std::shared_ptr<carbon::Device> device, VmaAllocator allocator, std::string name)
+    : device(std::move(device)), allocator(allocator), name(std::move(name)) {}
+
+carbon::RenderGraph::~RenderGraph() = default;
+
+auto carbon::RenderGraph::addPass(std::string passName, carbon::GraphExecuteFunction execute) -> carbon::GraphPass& {
+    return passes.emplace_back(std::move(passName), std::move(execute));
+}
+
+auto carbon::RenderGraph::createBuffer(std::string bufferName, const carbon::TransientBufferInfo& info) -> carbon::GraphResource {
+    resources.push_back({ .name = std::move(bufferName), .isImage = false, .bufferInfo = info });
+    return static_cast<carbon::GraphResource>(resources.size() - 1);
+}
+
+auto carbon::RenderGraph::createImage(std::string imageName, const carbon::TransientImageInfo& info) -> carbon::GraphResource {
+    resources.push_back({ .name = std::move(imageName), .isImage = true, .imageInfo = info });
+    return static_cast<carbon::GraphResource>(resources.size() - 1);
+}
+
+auto carbon::RenderGraph::importBuffer(carbon::Buffer* buffer, carbon::ResourceUsage initialUsage, carbon::ResourceUsage finalUsage)
+    -> carbon::GraphResource {
+    resources.push_back({
+        .isImage = false,
+        .importedBuffer = buffer,
+        .initialUsage = initialUsage,
+        .finalUsage = finalUsage,
+        .buffer = buffer->getHandle(),
+    });
+    return static_cast<carbon::GraphResource>(resources.size() - 1);
+}
+
+auto carbon::RenderGraph::importImage(carbon::Image* image, carbon::ResourceUsage initialUsage, carbon::ResourceUsage finalUsage)
+    -> carbon::GraphResource {
+    resources.push_back({
+        .isImage = true,
+        .importedImage = image,
+        .initialUsage = initialUsage,
+        .finalUsage = finalUsage,
+        .image = VkImage(*image),
+        .imageView = image->getImageView(),
+    });
+    return static_cast<carbon::GraphResource>(resources.size() - 1);
+}
+
+void carbon::RenderGraph::compile() {
+    destroyTransientResources();
+    compiledPasses.clear();
+    finalBarriers.clear();
+    statistics = { .passCount = static_cast<uint32_t>(passes.size()) };
+
+    cullPasses();
+    createTransientResources();
+    placeTransientResources(true);
+    placeTransientResources(false);
+    computeBarriers();
+}
+
+void carbon::RenderGraph::cullPasses() {
+    // Walk the passes backwards, keeping track of which resources still have to be produced
+    // by an earlier pass. Imported resources are always needed, as they outlive the frame.
+    std::vector<bool> needed(resources.size(), false);
+    for (size_t i = 0; i < resources.size(); ++i)
+        needed[i] = resources[i].isImported();
+
+    std::vector<uint32_t> remaining;
+    for (auto i = static_cast<uint32_t>(passes.size()); i-- > 0;) {
+        const auto& pass = passes[i];
+        bool alive = pass.sideEffects;
+        for (const auto& access : pass.accesses)
+            alive |= access.write && needed[access.resource];
+
+        if (!alive) {
+            ++statistics.culledPassCount;
+            continue;
+        }
+
+        // A write discards the previous contents, unless the pass reads them as well.
+        for (const auto& access : pass.accesses) {
+            if (access.write && !resources[access.resource].isImported())
+                needed[access.resource] = false;
+        }
+        for (const auto& access : pass.accesses) {
+            if (!access.write)
+                needed[access.resource] = true;
+        }
+        remaining.push_back(i);
+    }
+
+    std::reverse(remaining.begin(), remaining.end());
+    for (uint32_t i = 0; i < remaining.size(); ++i) {
+        compiledPasses.push_back({ .pass = remaining[i] });
+        for (const auto& access : passes[remaining[i]].accesses) {
+            auto& resource = resources[access.resource];
+            resource.firstPass = std::min(resource.firstPass, i);
+            resource.lastPass = std::max(resource.lastPass, i);
+        }
+    }
+}
+
+void carbon::RenderGraph::createTransientResources() {
+    for (auto& resource : resources) {
+        // Resources only used by culled passes are never created.
+        if (resource.isImported() || resource.firstPass == UINT32_MAX)
+            continue;
+
+        if (resource.isImage) {
+            VkImageCreateInfo imageCreateInfo = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                .imageType = VK_IMAGE_TYPE_2D,
+                .format = resource.imageInfo.format,
+                .extent = { resource.imageInfo.extent.width, resource.imageInfo.extent.height, 1 },
+                .mipLevels = 1,
+                .arrayLayers = 1,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .tiling = VK_IMAGE_TILING_OPTIMAL,
+                .usage = resource.imageInfo.usage,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            };
+            auto result = vkCreateImage(*device, &imageCreateInfo, nullptr, &resource.image);
+            checkResult(result, "Failed to create transient image");
+            vkGetImageMemoryRequirements(*device, resource.image, &resource.memoryRequirements);
+            device->setDebugUtilsName(resource.image, resource.name);
+        } else {
+            VkBufferCreateInfo bufferCreateInfo = {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                .size = resource.bufferInfo.size,
+                .usage = resource.bufferInfo.usage,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            };
+            auto result = vkCreateBuffer(*device, &bufferCreateInfo, nullptr, &resource.buffer);
+            checkResult(result, "Failed to create transient buffer");
+            vkGetBufferMemoryRequirements(*device, resource.buffer, &resource.memoryRequirements);
+            device->setDebugUtilsName(resource.buffer, resource.name);
+        }
+        statistics.unaliasedMemorySize += resource.memoryRequirements.size;
+    }
+}
+
+void carbon::RenderGraph::placeTransientResources(bool images) {
+    std::vector<Resource*> order;
+    for (auto& resource : resources) {
+        if (resource.isImage == images && !resource.isImported() && resource.firstPass != UINT32_MAX)
+            order.push_back(&resource);
+    }
+    if (order.empty())
+        return;
+
+    // Placing the biggest resources first keeps the total size close to the peak usage.
+    std::sort(order.begin(), order.end(),
+              [](const Resource* a, const Resource* b) { return a->memoryRequirements.size > b->memoryRequirements.size; });
+
+    VkMemoryRequirements heapRequirements = { .size = 0, .alignment = 1, .memoryTypeBits = ~0U };
+    std::vector<Resource*> placed;
+    for (auto* resource : order) {
+        const auto& requirements = resource->memoryRequirements;
+
+        // A resource fits either at the start of the heap or right after a resource which is
+        // alive at the same time.
+        std::vector<VkDeviceSize> candidates = { 0 };
+        for (const auto* other : placed) {
+            if (lifetimesOverlap(resource->firstPass, resource->lastPass, other->firstPass, other->lastPass))
+                candidates.push_back(
+                    carbon::Buffer::alignedSize(other->memoryOffset + other->memoryRequirements.size, requirements.alignment));
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        for (auto offset : candidates) {
+            const bool fits = std::none_of(placed.begin(), placed.end(), [&](const Resource* other) {
+                return lifetimesOverlap(resource->firstPass, resource->lastPass, other->firstPass, other->lastPass) &&
+                       offset < other->memoryOffset + other->memoryRequirements.size &&
+                       other->memoryOffset < offset + requirements.size;
+            });
+            if (fits) {
+                resource->memoryOffset = offset;
+                break;
+            }
+        }
+
+        // Any memory shared with another resource has to be synchronized on first use. This
+        // includes the first user of the memory, as the previous frame's last user precedes it.
+        for (auto* other : placed) {
+            if (resource->memoryOffset < other->memoryOffset + other->memoryRequirements.size &&
+                other->memoryOffset < resource->memoryOffset + requirements.size) {
+                resource->aliased = true;
+                other->aliased = true;
+            }
+        }
+
+        heapRequirements.size = std::max(heapRequirements.size, resource->memoryOffset + requirements.size);
+        heapRequirements.alignment = std::max(heapRequirements.alignment, requirements.alignment);
+        heapRequirements.memoryTypeBits &= requirements.memoryTypeBits;
+        placed.push_back(resource);
+    }
+
+    if (heapRequirements.memoryTypeBits == 0)
+        throw std::runtime_error(fmt::format("{}: transient resources share no common memory type", name));
+
+    VmaAllocationCreateInfo allocationInfo = {
+        .requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    };
+    VmaAllocation allocation = nullptr;
+    auto result = vmaAllocateMemory(allocator, &heapRequirements, &allocationInfo, &allocation, nullptr);
+    checkResult(result, "Failed to allocate transient memory");
+    transientAllocations.push_back(allocation);
+    statistics.transientMemorySize += heapRequirements.size;
+
+    if (auto* budget = device->getMemoryBudget(); budget != nullptr)
+        budget->trackAllocation(allocation, name);
+
+    for (auto* resource : placed) {
+        if (resource->isImage) {
+            result = vmaBindImageMemory2(allocator, allocation, resource->memoryOffset, resource->image, nullptr);
+            checkResult(result, "Failed to bind transient image memory");
+
+            VkImageViewCreateInfo viewCreateInfo = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                .image = resource->image,
+                .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                .format = resource->imageInfo.format,
+                .subresourceRange = getSubresourceRange(*resource),
+            };
+            result = vkCreateImageView(*device, &viewCreateInfo, nullptr, &resource->imageView);
+            checkResult(result, "Failed to create transient image view");
+        } else {
+            result = vmaBindBufferMemory2(allocator, allocation, resource->memoryOffset, resource->buffer, nullptr);
+            checkResult(result, "Failed to bind transient buffer memory");
+        }
+    }
+}
+
+void carbon::RenderGraph::computeBarriers() {
+    struct ResourceState {
+        // The stages and accesses of the last write, which every later access has to wait on.
+        VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 writeAccesses = VK_ACCESS_2_NONE;
+        // The stages and accesses which already wait on the last write. Reads in these are merged
+        // without a barrier, and the next write has to wait on all of them.
+        VkPipelineStageFlags2 syncedStages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 syncedAccesses = VK_ACCESS_2_NONE;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    std::vector<ResourceState> states(resources.size());
+    for (size_t i = 0; i < resources.size(); ++i) {
+        if (!resources[i].isImported())
+            continue;
+        const auto initial = carbon::getResourceUsageInfo(resources[i].initialUsage);
+        auto& state = states[i];
+        state.layout = initial.imageLayout;
+        if ((initial.accessMask & carbon::writeAccessMask) != 0) {
+            state.writeStages = initial.stageMask;
+            state.writeAccesses = initial.accessMask & carbon::writeAccessMask;
+        } else {
+            state.syncedStages = initial.stageMask;
+            state.syncedAccesses = initial.accessMask;
+        }
+    }
+
+    // The list and index of the first barrier of every transient resource, which has to wait
+    // on the previous frame.
+    std::vector<std::pair<std::vector<Barrier>*, size_t>> firstBarriers(resources.size(), { nullptr, 0 });
+    std::vector<bool> used(resources.size(), false);
+
+    auto transition = [&](std::vector<Barrier>& barriers, carbon::GraphResource index, const carbon::ResourceUsageInfo& usage) {
+        const auto& resource = resources[index];
+        auto& state = states[index];
+        const bool firstUse = !used[index] && !resource.isImported();
+        used[index] = true;
+
+        const bool write = (usage.accessMask & carbon::writeAccessMask) != 0;
+        const bool layoutChange = resource.isImage && state.layout != usage.imageLayout;
+        if (!firstUse && !write && !layoutChange) {
+            // A read only needs a barrier if its stages or accesses do not wait on the last write yet.
+            const bool synced = (usage.stageMask & ~state.syncedStages) == 0 && (usage.accessMask & ~state.syncedAccesses) == 0;
+            if (!synced && state.writeStages != VK_PIPELINE_STAGE_2_NONE) {
+                barriers.push_back({
+                    index,
+                    carbon::ResourceUsageInfo { state.writeStages, state.writeAccesses, state.layout },
+                    usage,
+                });
+            }
+            state.syncedStages |= usage.stageMask;
+            state.syncedAccesses |= usage.accessMask;
+            return;
+        }
+
+        // Writes and layout transitions wait on the last write and every read since then.
+        barriers.push_back({
+            index,
+            carbon::ResourceUsageInfo { state.writeStages | state.syncedStages, state.writeAccesses, state.layout },
+            usage,
+        });
+        if (firstUse)
+            firstBarriers[index] = { &barriers, barriers.size() - 1 };
+
+        // A layout transition is a write as well, which later reads have to wait on.
+        state.writeStages = usage.stageMask;
+        state.writeAccesses = usage.accessMask & carbon::writeAccessMask;
+        state.syncedStages = usage.stageMask;
+        state.syncedAccesses = usage.accessMask;
+        state.layout = usage.imageLayout;
+    };
+
+    for (auto& compiledPass : compiledPasses) {
+        // Merge the accesses of a pass to the same resource into a single usage.
+        std::vector<std::pair<carbon::GraphResource, carbon::ResourceUsageInfo>> usages;
+        for (const auto& access : passes[compiledPass.pass].accesses) {
+            auto info = carbon::getResourceUsageInfo(access.usage);
+            auto it = std::find_if(usages.begin(), usages.end(), [&](const auto& usage) { return usage.first == access.resource; });
+            if (it == usages.end()) {
+                usages.emplace_back(access.resource, info);
+                continue;
+            }
+            it->second.stageMask |= info.stageMask;
+            it->second.accessMask |= info.accessMask;
+            if (access.write)
+                it->second.imageLayout = info.imageLayout;
+        }
+
+        for (const auto& [resource, usage] : usages)
+            transition(compiledPass.barriers, resource, usage);
+        statistics.barrierCount += static_cast<uint32_t>(compiledPass.barriers.size());
+    }
+
+    for (carbon::GraphResource i = 0; i < resources.size(); ++i) {
+        if (resources[i].isImported() && resources[i].finalUsage != carbon::ResourceUsage::Undefined)
+            transition(finalBarriers, i, carbon::getResourceUsageInfo(resources[i].finalUsage));
+    }
+    statistics.barrierCount += static_cast<uint32_t>(finalBarriers.size());
+
+    // The graph is executed every frame, and the previous frame may still access the same
+    // transient resources. Their first use therefore waits on their last use, which wraps
+    // around. Memory shared with other resources waits on everything instead, as the previous
+    // user of the memory is not known. The previous contents are discarded either way.
+    for (size_t i = 0; i < resources.size(); ++i) {
+        const auto [barriers, barrierIndex] = firstBarriers[i];
+        if (barriers == nullptr)
+            continue;
+        auto& src = (*barriers)[barrierIndex].src;
+        if (resources[i].aliased) {
+            src.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+            src.accessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
+        } else {
+            src.stageMask = states[i].writeStages | states[i].syncedStages;
+            src.accessMask = states[i].writeAccesses;
+        }
+    }
+
+    for (size_t i = 0; i < resources.size(); ++i) {
+        if (resources[i].importedImage != nullptr)
+            resources[i].finalLayout = states[i].layout;
+    }
+}
+
+auto carbon::RenderGraph::getSubresourceRange(const Resource& resource) const -> VkImageSubresourceRange {
+    const auto format = resource.isImported() ? resource.importedImage->getImageFormat() : resource.imageInfo.format;
+    return {
+        .aspectMask = getAspectMask(format),
+        .baseMipLevel = 0,
+        .levelCount = VK_REMAINING_MIP_LEVELS,
+        .baseArrayLayer = 0,
+        .layerCount = VK_REMAINING_ARRAY_LAYERS,
+    };
+}
+
+void carbon::RenderGraph::recordBarrier(carbon::CommandBuffer* cmdBuffer, const Barrier& barrier) const {
+    const auto& resource = resources[barrier.resource];
+    if (resource.isImage) {
+        cmdBuffer->imageBarrier(resource.image, barrier.src, barrier.dst, getSubresourceRange(resource));
+    } else {
+        cmdBuffer->bufferBarrier(resource.buffer, barrier.src, barrier.dst);
+    }
+}
+
+void carbon::RenderGraph::execute(carbon::CommandBuffer* cmdBuffer) const {
+    for (const auto& compiledPass : compiledPasses) {
+        for (const auto& barrier : compiledPass.barriers)
+            recordBarrier(cmdBuffer, barrier);
+        // All barriers of a pass are recorded with a single call.
+        cmdBuffer->flushBarriers();
+
+        const auto& pass = passes[compiledPass.pass];
+        if (pass.execute)
+            pass.execute(cmdBuffer, *this);
+    }
+
+    for (const auto& barrier : finalBarriers)
+        recordBarrier(cmdBuffer, barrier);
+    cmdBuffer->flushBarriers();
+
+    for (const auto& resource : resources) {
+        if (resource.importedImage != nullptr)
+            resource.importedImage->currentLayouts[0] = resource.finalLayout;
+    }
+}
+
+void carbon::RenderGraph::destroyTransientResources() {
+    for (auto& resource : resources) {
+        resource.firstPass = UINT32_MAX;
+        resource.lastPass = 0;
+        if (resource.isImported())
+            continue;
+
+        if (resource.imageView != nullptr)
+            vkDestroyImageView(*device, resource.imageView, nullptr);
+        if (resource.image != nullptr)
+            vkDestroyImage(*device, resource.image, nullptr);
+        if (resource.buffer != nullptr)
+            vkDestroyBuffer(*device, resource.buffer, nullptr);
+        resource.imageView = nullptr;
+        resource.image = nullptr;
+        resource.buffer = nullptr;
+        resource.memoryOffset = 0;
+        resource.aliased = false;
+    }
+
+    for (auto allocation : transientAllocations) {
+        if (auto* budget = device->getMemoryBudget(); budget != nullptr)
+            budget->untrackAllocation(allocation);
+        vmaFreeMemory(allocator, allocation);
+    }
+    transientAllocations.clear();
+}
+
+void carbon::RenderGraph::reset() {
+    destroyTransientResources();
+    passes.clear();
+    resources.clear();
+    compiledPasses.clear();
+    finalBarriers.clear();
+    statistics = {};
+}
+
+void carbon::RenderGraph::destroy() { reset(); }
+
+auto carbon::RenderGraph::getBuffer(carbon::GraphResource resource) const -> VkBuffer { return resources[resource].buffer; }
+
+auto carbon::RenderGraph::getImage(carbon::GraphResource resource) const -> VkImage { return resources[resource].image; }
+
+auto carbon::RenderGraph::getImageView(carbon::GraphResource resource) const -> VkImageView { return resources[resource].imageView; }
+
+auto carbon::RenderGraph::getStatistics() const -> const carbon::RenderGraphStatistics& { return statistics; }
@@ -1,50 +1,160 @@
 #pragma once
 
+#include <array>
 #include <memory>
 #include <vector>
 
+#include <carbon/base/resource_usage.hpp>
 #include <carbon/shaders/shader_stage.hpp>
 #include <carbon/vulkan.hpp>
 
 namespace carbon {
     class Buffer;
+    struct BufferArenaAllocation;
     class CommandPool;
+    class CommandPoolManager;
     class Device;
+    class Image;
     class Pipeline;
     class Queue;
     class StagingBuffer;
 
+    /** Counts the commands which were skipped because they would not have changed any state. */
+    struct CommandBufferStatistics {
+        uint64_t skippedPipelineBinds = 0;
+        uint64_t skippedDescriptorSetBinds = 0;
+        uint64_t skippedIndexBufferBinds = 0;
+        uint64_t skippedVertexBufferBinds = 0;
+        uint64_t skippedViewports = 0;
+        uint64_t skippedScissors = 0;
+    };
+
     class CommandBuffer {
         friend class carbon::CommandPool;
+        friend class carbon::CommandPoolManager;
 
         carbon::Device* device = nullptr;
         VkCommandBuffer handle = nullptr;
 
         VkCommandBufferUsageFlags usageFlags = 0;
+        // Set by the command pool from the capabilities of its queue family. Barriers derived from
+        // resource usages only keep the stages and accesses the queue supports.
+        carbon::SupportedUsage supportedUsage = {};
+
+        // Barriers are only collected and then recorded with a single vkCmdPipelineBarrier2
+        // right before the next command which depends on them.
+        mutable std::vector<VkMemoryBarrier2> pendingMemoryBarriers = {};
+        mutable std::vector<VkBufferMemoryBarrier2> pendingBufferBarriers = {};
+        mutable std::vector<VkImageMemoryBarrier2> pendingImageBarriers = {};
+
+        // Vulkan guarantees at least four, almost every device supports eight or more.
+        static constexpr uint32_t maxDescriptorSets = 8;
+
+        struct BindPointState {
+            VkPipeline pipeline = nullptr;
+            VkPipelineLayout layout = nullptr;
+            std::array<VkDescriptorSet, maxDescriptorSets> descriptorSets = {};
+        };
+
+        // The currently bound state, used to skip commands which would not change anything.
+        // Graphics, compute and ray tracing pipelines each have their own bind point.
+        mutable std::array<BindPointState, 3> bindPoints = {};
+        mutable VkBuffer indexBuffer = nullptr;
+        mutable VkDeviceSize indexBufferOffset = 0;
+        mutable VkIndexType indexType = VK_INDEX_TYPE_MAX_ENUM;
+        mutable VkBuffer vertexBuffer = nullptr;
+        mutable VkDeviceSize vertexBufferOffset = 0;
+        mutable VkViewport viewport = {};
+        mutable bool viewportSet = false;
+        mutable VkRect2D scissor = {};
+        mutable bool scissorSet = false;
+        mutable carbon::CommandBufferStatistics statistics = {};
+
+        [[nodiscard]] auto getBindPointState(VkPipelineBindPoint bindPoint) const -> BindPointState&;
+        void bindIndexBufferHandle(VkBuffer buffer, VkDeviceSize offset, VkIndexType newIndexType) const;
+        void bindVertexBufferHandle(VkBuffer buffer, VkDeviceSize offset) const;
+        /** Forgets all bound state, e.g. because the command buffer was reset or executed secondary buffers. */
+        void invalidateState() const;
 
     public:
         explicit CommandBuffer(VkCommandBuffer handle, carbon::Device* device, VkCommandBufferUsageFlags usageFlags);
 
         void begin();
+        /**
+         * Begins a secondary command buffer which continues the dynamic rendering instance
+         * started in the primary buffer with VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT.
+         */
+        void beginSecondary(const VkCommandBufferInheritanceRenderingInfo* renderingInfo);
+        /** Ends recording. The queue is only used to print checkpoints on failure and may be nullptr. */
         void end(carbon::Queue* queue);
 
+        /**
+         * Queues barriers between two usages of a resource, deriving stages, access masks and
+         * image layouts from the usages. They are flushed together before the next draw,
+         * dispatch, copy, build or rendering command recorded through this class. Stages and
+         * accesses the queue family of the command pool does not support are left out.
+         */
+        void barrier(carbon::ResourceUsage srcUsage, carbon::ResourceUsage dstUsage) const;
+        void bufferBarrier(const carbon::Buffer* buffer, carbon::ResourceUsage srcUsage, carbon::ResourceUsage dstUsage,
+                           VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
+        void imageBarrier(VkImage image, carbon::ResourceUsage srcUsage, carbon::ResourceUsage dstUsage,
+                          const VkImageSubresourceRange& subresourceRange) const;
+        /** Variants taking the raw stages and accesses, e.g. for the combined state of several reads. */
+        void bufferBarrier(VkBuffer buffer, const carbon::ResourceUsageInfo& src, const carbon::ResourceUsageInfo& dst,
+                           VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
+        void imageBarrier(VkImage image, const carbon::ResourceUsageInfo& src, const carbon::ResourceUsageInfo& dst,
+                          const VkImageSubresourceRange& subresourceRange) const;
+        /** Records all queued barriers. Has to be called before recording commands on the raw handle. */
+        void flushBarriers() const;
+
+        [[nodiscard]] auto getStatistics() const -> const carbon::CommandBufferStatistics&;
+        void resetStatistics();
+
         /* Vulkan commands */
         void beginRendering(const VkRenderingInfo* renderingInfo) const;
+        /** Binds a single descriptor set at the given index of the pipeline's layout, unless it is bound already. */
+        void bindDescriptorSet(carbon::Pipeline* pipeline, uint32_t set, VkDescriptorSet descriptorSet) const;
+        /** Binds the pipeline's descriptor sets, only rebinding the range of sets which changed. */
         void bindDescriptorSets(carbon::Pipeline* pipeline) const;
         void bindIndexBuffer(carbon::Buffer* buffer, VkDeviceSize offset, VkIndexType indexType = VK_INDEX_TYPE_UINT32) const;
         void bindIndexBuffer(carbon::StagingBuffer* buffer, VkDeviceSize offset, VkIndexType indexType = VK_INDEX_TYPE_UINT32) const;
+        void bindIndexBuffer(const carbon::BufferArenaAllocation& allocation, VkIndexType indexType = VK_INDEX_TYPE_UINT32) const;
         void bindPipeline(carbon::Pipeline* pipeline) const;
         void bindVertexBuffer(carbon::Buffer* buffer, VkDeviceSize* offset) const;
         void bindVertexBuffer(carbon::StagingBuffer* buffer, VkDeviceSize* offset) const;
+        void bindVertexBuffer(const carbon::BufferArenaAllocation& allocation) const;
         void buildAccelerationStructures(const std::vector<VkAccelerationStructureBuildGeometryInfoKHR>& geometryInfos,
                                          const std::vector<VkAccelerationStructureBuildRangeInfoKHR*>& rangeInfos);
+        void blitImage(VkImage srcImage, VkImageLayout srcImageLayout, VkImage dstImage, VkImageLayout dstImageLayout,
+                       const std::vector<VkImageBlit>& regions, VkFilter filter) const;
+        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, const std::vector<VkBufferCopy>& regions) const;
+        void copyBufferToImage(VkBuffer srcBuffer, VkImage dstImage, VkImageLayout dstImageLayout,
+                               const std::vector<VkBufferImageCopy>& regions) const;
+        void copyImage(VkImage srcImage, VkImageLayout srcImageLayout, VkImage dstImage, VkImageLayout dstImageLayout,
+                       const std::vector<VkImageCopy>& regions) const;
+        void copyImageToBuffer(VkImage srcImage, VkImageLayout srcImageLayout, VkBuffer dstBuffer,
+                               const std::vector<VkBufferImageCopy>& regions) const;
+        void dispatch(uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1) const;
         void drawIndexed(uint32_t indexCount, int32_t indexOffset = 0, uint32_t instanceCount = 1, uint32_t firstIndex = 1) const;
+        void drawIndexedIndirect(const carbon::Buffer* buffer, VkDeviceSize offset, uint32_t drawCount,
+                                 uint32_t stride = sizeof(VkDrawIndexedIndirectCommand)) const;
+        /**
+         * Draws min(count, maxDrawCount) indirect draws, where count is read from the count buffer
+         * by the GPU. Requires VK_KHR_draw_indirect_count, which is enabled when it is supported,
+         * and throws otherwise. See Device::supportsDrawIndirectCount.
+         */
+        void drawIndexedIndirectCount(const carbon::Buffer* buffer, VkDeviceSize offset, const carbon::Buffer* countBuffer,
+                                      VkDeviceSize countOffset, uint32_t maxDrawCount,
+                                      uint32_t stride = sizeof(VkDrawIndexedIndirectCommand)) const;
         void endRendering() const;
+        void executeCommands(const std::vector<VkCommandBuffer>& cmdBuffers) const;
+        void fillBuffer(const carbon::Buffer* buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t data) const;
         void pipelineBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlags,
                              uint32_t memoryBarrierCount, const VkMemoryBarrier* pMemoryBarriers, uint32_t bufferMemoryBarrierCount,
                              const VkBufferMemoryBarrier* pBufferMemoryBarriers, uint32_t imageMemoryBarrierCount,
                              const VkImageMemoryBarrier* pImageMemoryBarriers);
-        void pushConstants(carbon::Pipeline* pipeline, carbon::ShaderStage stages, uint32_t size, void* values, uint32_t offset = 0) const;
+        void pushConstants(carbon::Pipeline* pipeline, carbon::ShaderStage stages, uint32_t size, const void* values,
+                           uint32_t offset = 0) const;
         void setScissor(VkRect2D* scissor) const;
         void setViewport(float width, float height, float maxDepth, float x = 0, float y = 0, float minDepth = 0.0f) const;
         void traceRays(VkStridedDeviceAddressRegionKHR* rayGenSbt, VkStridedDeviceAddressRegionKHR* missSbt,
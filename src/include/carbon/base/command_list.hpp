@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <carbon/base/resource_usage.hpp>
+#include <carbon/shaders/shader_stage.hpp>
+#include <carbon/vulkan.hpp>
+
+namespace carbon {
+    class Buffer;
+    class CommandBuffer;
+    class Pipeline;
+
+    /** Identifies a recorded command, so that its parameters can be patched later on. */
+    using CommandHandle = uint32_t;
+
+    // A CommandList records the same commands as a CommandBuffer into a compact, linear byte
+    // stream on the CPU. It can be recorded once, patched and then replayed into any number of
+    // command buffers, which is a lot cheaper than walking the scene to build the same calls
+    // again. Replaying does not allocate, and clearing keeps the memory for the next recording.
+    // Replayed commands go through the CommandBuffer, so redundant binds are still skipped and
+    // barriers are still batched. Referenced pipelines and buffers have to outlive the list.
+    class CommandList {
+        enum class CommandType : uint32_t {
+            Barrier,
+            BindDescriptorSet,
+            BindDescriptorSets,
+            BindIndexBuffer,
+            BindPipeline,
+            BindVertexBuffer,
+            BufferBarrier,
+            Dispatch,
+            DrawIndexed,
+            DrawIndexedIndirect,
+            DrawIndexedIndirectCount,
+            ImageBarrier,
+            PushConstants,
+            SetScissor,
+            SetViewport,
+            TraceRays,
+        };
+
+        struct CommandHeader {
+            CommandType type;
+            // The size of the entire command including this header, a multiple of commandAlignment.
+            uint32_t size;
+        };
+
+        struct BarrierCommand {
+            carbon::ResourceUsage srcUsage;
+            carbon::ResourceUsage dstUsage;
+        };
+        struct BindDescriptorSetCommand {
+            carbon::Pipeline* pipeline;
+            VkDescriptorSet descriptorSet;
+            uint32_t set;
+        };
+        struct BindIndexBufferCommand {
+            carbon::Buffer* buffer;
+            VkDeviceSize offset;
+            VkIndexType indexType;
+        };
+        struct BindVertexBufferCommand {
+            carbon::Buffer* buffer;
+            VkDeviceSize offset;
+        };
+        struct BufferBarrierCommand {
+            const carbon::Buffer* buffer;
+            VkDeviceSize offset;
+            VkDeviceSize size;
+            carbon::ResourceUsage srcUsage;
+            carbon::ResourceUsage dstUsage;
+        };
+        struct DispatchCommand {
+            uint32_t groupCountX;
+            uint32_t groupCountY;
+            uint32_t groupCountZ;
+        };
+        struct DrawIndexedCommand {
+            uint32_t indexCount;
+            uint32_t instanceCount;
+            uint32_t firstIndex;
+            int32_t vertexOffset;
+        };
+        struct DrawIndexedIndirectCommand {
+            const carbon::Buffer* buffer;
+            const carbon::Buffer* countBuffer;
+            VkDeviceSize offset;
+            VkDeviceSize countOffset;
+            // The draw count, or the maximum draw count if a count buffer is used.
+            uint32_t drawCount;
+            uint32_t stride;
+        };
+        struct ImageBarrierCommand {
+            VkImage image;
+            VkImageSubresourceRange subresourceRange;
+            carbon::ResourceUsage srcUsage;
+            carbon::ResourceUsage dstUsage;
+        };
+        // The push constant values directly follow this command in the stream.
+        struct PushConstantsCommand {
+            carbon::Pipeline* pipeline;
+            carbon::ShaderStage stages;
+            uint32_t offset;
+            uint32_t size;
+        };
+        struct SetViewportCommand {
+            float width;
+            float height;
+            float maxDepth;
+            float x;
+            float y;
+            float minDepth;
+        };
+        struct TraceRaysCommand {
+            VkStridedDeviceAddressRegionKHR rayGenSbt;
+            VkStridedDeviceAddressRegionKHR missSbt;
+            VkStridedDeviceAddressRegionKHR hitSbt;
+            VkStridedDeviceAddressRegionKHR callableSbt;
+            VkExtent3D imageSize;
+        };
+
+        static constexpr size_t commandAlignment = 8;
+
+        std::vector<std::byte> stream = {};
+        uint32_t commandCount = 0;
+
+        auto append(CommandType type, const void* command, size_t commandSize, const void* data = nullptr, size_t dataSize = 0)
+            -> carbon::CommandHandle;
+        template <typename T>
+        auto append(CommandType type, const T& command) -> carbon::CommandHandle {
+            return append(type, &command, sizeof(T));
+        }
+
+        // The commands are copied in and out of the stream, which keeps them free of any
+        // alignment or aliasing requirements.
+        template <typename T>
+        [[nodiscard]] auto read(size_t offset) const -> T;
+        template <typename T>
+        void write(size_t offset, const T& command);
+        /** Checks that the handle points to a command of the given type and returns the offset of its payload. */
+        [[nodiscard]] auto getPayloadOffset(carbon::CommandHandle handle, CommandType type) const -> size_t;
+
+    public:
+        explicit CommandList(size_t reservedSize = 4096);
+
+        /** Removes all commands, but keeps the memory. */
+        void clear();
+        /** Records every command of this list into the given command buffer, in order. */
+        void replay(carbon::CommandBuffer* cmdBuffer) const;
+
+        /* Recorded commands, matching the CommandBuffer functions with the same names. */
+        auto barrier(carbon::ResourceUsage srcUsage, carbon::ResourceUsage dstUsage) -> carbon::CommandHandle;
+        auto bindDescriptorSet(carbon::Pipeline* pipeline, uint32_t set, VkDescriptorSet descriptorSet) -> carbon::CommandHandle;
+        /** Binds the descriptor sets the pipeline holds at the time of the replay. */
+        auto bindDescriptorSets(carbon::Pipeline* pipeline) -> carbon::CommandHandle;
+        auto bindIndexBuffer(carbon::Buffer* buffer, VkDeviceSize offset, VkIndexType indexType = VK_INDEX_TYPE_UINT32)
+            -> carbon::CommandHandle;
+        auto bindPipeline(carbon::Pipeline* pipeline) -> carbon::CommandHandle;
+        auto bindVertexBuffer(carbon::Buffer* buffer, VkDeviceSize offset) -> carbon::CommandHandle;
+        auto bufferBarrier(const carbon::Buffer* buffer, carbon::ResourceUsage srcUsage, carbon::ResourceUsage dstUsage,
+                           VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) -> carbon::CommandHandle;
+        auto dispatch(uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1) -> carbon::CommandHandle;
+        auto drawIndexed(uint32_t indexCount, int32_t vertexOffset = 0, uint32_t instanceCount = 1, uint32_t firstIndex = 1)
+            -> carbon::CommandHandle;
+        auto drawIndexedIndirect(const carbon::Buffer* buffer, VkDeviceSize offset, uint32_t drawCount,
+                                 uint32_t stride = sizeof(VkDrawIndexedIndirectCommand)) -> carbon::CommandHandle;
+        auto drawIndexedIndirectCount(const carbon::Buffer* buffer, VkDeviceSize offset, const carbon::Buffer* countBuffer,
+                                      VkDeviceSize countOffset, uint32_t maxDrawCount,
+                                      uint32_t stride = sizeof(VkDrawIndexedIndirectCommand)) -> carbon::CommandHandle;
+        auto imageBarrier(VkImage image, carbon::ResourceUsage srcUsage, carbon::ResourceUsage dstUsage,
+                          const VkImageSubresourceRange& subresourceRange) -> carbon::CommandHandle;
+        /** Copies size bytes of values into the list. */
+        auto pushConstants(carbon::Pipeline* pipeline, carbon::ShaderStage stages, uint32_t size, const void* values, uint32_t offset = 0)
+            -> carbon::CommandHandle;
+        auto setScissor(const VkRect2D& scissor) -> carbon::CommandHandle;
+        auto setViewport(float width, float height, float maxDepth, float x = 0, float y = 0, float minDepth = 0.0f)
+            -> carbon::CommandHandle;
+        auto traceRays(const VkStridedDeviceAddressRegionKHR& rayGenSbt, const VkStridedDeviceAddressRegionKHR& missSbt,
+                       const VkStridedDeviceAddressRegionKHR& hitSbt, const VkStridedDeviceAddressRegionKHR& callableSbt,
+                       VkExtent3D imageSize) -> carbon::CommandHandle;
+
+        /* Patches of recorded commands. The handle has to refer to a command of the matching type. */
+        void patchDescriptorSet(carbon::CommandHandle handle, VkDescriptorSet descriptorSet);
+        void patchDispatch(carbon::CommandHandle handle, uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1);
+        /** Changes the index and instance count of a drawIndexed command. */
+        void patchDrawIndexed(carbon::CommandHandle handle, uint32_t indexCount, uint32_t instanceCount = 1);
+        /** Changes the draw count of a drawIndexedIndirect or the maximum draw count of a drawIndexedIndirectCount command. */
+        void patchDrawCount(carbon::CommandHandle handle, uint32_t drawCount);
+        /** Overwrites size bytes of the recorded push constant block, starting at offset bytes into the block. */
+        void patchPushConstants(carbon::CommandHandle handle, const void* values, uint32_t size, uint32_t offset = 0);
+
+        [[nodiscard]] auto getCommandCount() const -> uint32_t;
+        /** Gets the size of the recorded stream in bytes. */
+        [[nodiscard]] auto getSize() const -> size_t;
+    };
+} // namespace carbon
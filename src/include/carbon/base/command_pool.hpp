@@ -3,6 +3,7 @@
 #include <memory>
 #include <vector>
 
+#include <carbon/base/resource_usage.hpp>
 #include <carbon/vulkan.hpp>
 
 namespace carbon {
@@ -14,6 +15,8 @@ namespace carbon {
         std::shared_ptr<carbon::Device> device;
 
         VkCommandPool handle = nullptr;
+        // The stages and accesses of the queue family, handed to every allocated command buffer.
+        carbon::SupportedUsage supportedUsage = {};
 
     public:
         explicit CommandPool(std::shared_ptr<carbon::Device> device, std::string name);
@@ -25,5 +28,7 @@ namespace carbon {
             -> std::vector<std::shared_ptr<carbon::CommandBuffer>>;
         void destroy();
         void freeBuffers(std::initializer_list<carbon::CommandBuffer*> commandBuffers);
+        /** Resets every command buffer allocated from this pool back to the initial state. */
+        void reset(VkCommandPoolResetFlags flags = 0);
     };
 } // namespace carbon
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <carbon/vulkan.hpp>
+
+namespace carbon {
+    class CommandBuffer;
+    class CommandPool;
+    class Device;
+    class Fence;
+
+    // Command pools are not thread safe, so every recording thread needs its own pool, and a
+    // pool can only be reset once the GPU is done with every frame that used it. The
+    // CommandPoolManager therefore keeps one pool per frame in flight and per thread. Command
+    // buffers are allocated once and handed out again after the frame's pools have been reset,
+    // so that no command buffers are allocated or freed during regular frames.
+    class CommandPoolManager {
+        struct ThreadPools {
+            std::unique_ptr<carbon::CommandPool> pool;
+            std::vector<std::shared_ptr<carbon::CommandBuffer>> primaryBuffers = {};
+            std::vector<std::shared_ptr<carbon::CommandBuffer>> secondaryBuffers = {};
+            size_t usedPrimaryBuffers = 0;
+            size_t usedSecondaryBuffers = 0;
+        };
+
+        std::shared_ptr<carbon::Device> device;
+        const std::string name;
+
+        // Indexed by [frameIndex][threadIndex].
+        std::vector<std::vector<ThreadPools>> pools = {};
+
+    public:
+        explicit CommandPoolManager(std::shared_ptr<carbon::Device> device, std::string name = "commandPoolManager");
+        ~CommandPoolManager();
+
+        void create(uint32_t queueFamilyIndex, uint32_t framesInFlight, uint32_t threadCount);
+        void destroy();
+
+        /**
+         * Gets a command buffer in the initial state for the given frame and thread. It may only
+         * be used by that thread and stays valid until the frame is reset. This is lock-free, as
+         * every thread has its own pools.
+         */
+        [[nodiscard]] auto getCommandBuffer(uint32_t frameIndex, uint32_t threadIndex,
+                                            VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                                            VkCommandBufferUsageFlags usageFlags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT)
+            -> carbon::CommandBuffer*;
+
+        /**
+         * Recycles every command buffer of the given frame with a single vkResetCommandPool per
+         * thread. If a fence is given, this first waits for it to signal, otherwise the caller
+         * has to guarantee that the frame's command buffers are no longer in use.
+         */
+        void resetFrame(uint32_t frameIndex, carbon::Fence* fence = nullptr);
+
+        [[nodiscard]] auto getFrameCount() const -> uint32_t;
+        [[nodiscard]] auto getThreadCount() const -> uint32_t;
+    };
+} // namespace carbon
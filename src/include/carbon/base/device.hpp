@@ -1,17 +1,39 @@
 #pragma once
 
+#include <deque>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <utility>
 
 #include <carbon/vulkan.hpp>
 
 namespace carbon {
     class Instance;
+    class MemoryBudget;
     class PhysicalDevice;
+    class Queue;
     class Swapchain;
 
     class Device {
         std::shared_ptr<carbon::PhysicalDevice> physicalDevice;
         vkb::Device handle = {};
+        std::shared_ptr<carbon::MemoryBudget> memoryBudget;
+
+        // Several carbon::Queue objects can wrap the same VkQueue, e.g. when the transfer queue
+        // falls back to the graphics queue, so the mutexes are kept per VkQueue here.
+        mutable std::mutex queueMutexesMutex;
+        mutable std::map<VkQueue, std::shared_ptr<std::mutex>> queueMutexes = {};
+
+        struct RetiredObject {
+            uint64_t value = 0;
+            std::function<void()> destroy;
+        };
+
+        // Objects waiting to be destroyed, in the order they were retired on each queue.
+        std::mutex retireMutex;
+        std::map<const carbon::Queue*, std::deque<RetiredObject>> retiredObjects = {};
 
     public:
         PFN_vkAcquireNextImageKHR vkAcquireNextImageKHR = nullptr;
@@ -20,7 +42,9 @@ namespace carbon {
         PFN_vkCreateSwapchainKHR vkCreateSwapchainKHR = nullptr;
         PFN_vkCmdBeginRendering vkCmdBeginRendering = nullptr;
         PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructuresKHR = nullptr;
+        PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCountKHR = nullptr;
         PFN_vkCmdEndRendering vkCmdEndRendering = nullptr;
+        PFN_vkCmdPipelineBarrier2 vkCmdPipelineBarrier2 = nullptr;
         PFN_vkCmdSetCheckpointNV vkCmdSetCheckpointNV = nullptr;
         PFN_vkCmdTraceRaysKHR vkCmdTraceRaysKHR = nullptr;
         PFN_vkDestroyAccelerationStructureKHR vkDestroyAccelerationStructureKHR = nullptr;
@@ -31,17 +55,38 @@ namespace carbon {
         PFN_vkGetSwapchainImagesKHR vkGetSwapchainImagesKHR = nullptr;
         PFN_vkSetDebugUtilsObjectNameEXT vkSetDebugUtilsObjectNameEXT = nullptr;
         PFN_vkQueuePresentKHR vkQueuePresentKHR = nullptr;
+        PFN_vkQueueSubmit2 vkQueueSubmit2 = nullptr;
 
         explicit Device() = default;
 
         void create(std::shared_ptr<carbon::PhysicalDevice> physicalDevice);
+        /**
+         * Runs the destroy functions of every retired object whose submission has completed,
+         * all at once. This should be called once per frame and never blocks. Returns the number
+         * of destroyed objects.
+         */
+        auto collectRetired() -> size_t;
         void createDescriptorPool(const uint32_t maxSets, const std::vector<VkDescriptorPoolSize>& poolSizes,
                                   VkDescriptorPool* descriptorPool);
         void destroy() const;
+        /** Waits for the submissions of every retired object and destroys all of them. Call this before destroy. */
+        void flushRetired();
 
+        /**
+         * Finds the best queue of the given type and returns it together with its family index.
+         * Compute and transfer queues prefer a queue family dedicated to that type, then one
+         * separate from graphics, and finally fall back to the graphics queue.
+         */
+        [[nodiscard]] auto findQueue(vkb::QueueType queueType) const -> std::pair<VkQueue, uint32_t>;
         [[nodiscard]] VkQueue getQueue(vkb::QueueType queueType) const;
         [[nodiscard]] uint32_t getQueueIndex(vkb::QueueType queueType) const;
+        /** Gets the mutex guarding submissions to the given queue. */
+        [[nodiscard]] auto getQueueMutex(VkQueue queue) const -> std::shared_ptr<std::mutex>;
+        /** Gets the memory budget resources report their allocations to, or nullptr if none was set. */
+        [[nodiscard]] auto getMemoryBudget() const -> carbon::MemoryBudget*;
         [[nodiscard]] auto getPhysicalDevice() const -> std::shared_ptr<carbon::PhysicalDevice>;
+        /** Checks whether VK_KHR_draw_indirect_count was enabled, which is needed to read draw counts from buffers. */
+        [[nodiscard]] bool supportsDrawIndirectCount() const;
         [[nodiscard]] auto waitIdle() const -> VkResult;
 
         template <class T>
@@ -49,6 +94,17 @@ namespace carbon {
             return reinterpret_cast<T>(vkGetDeviceProcAddr(handle, functionName.c_str()));
         }
 
+        /**
+         * Takes ownership of an object which is still used by the submission of the given queue
+         * with the given timeline value. Destroy is called by collectRetired once that submission
+         * has completed, instead of having to wait for the device to become idle. This is thread
+         * safe. Objects retired on the same queue are destroyed in order, so retiring with an
+         * older value than before only delays the destruction.
+         */
+        void retire(const carbon::Queue* queue, uint64_t value, std::function<void()> destroy);
+
+        void setMemoryBudget(std::shared_ptr<carbon::MemoryBudget> budget);
+
         void setDebugUtilsName(const VkAccelerationStructureKHR& as, const std::string& name) const;
         void setDebugUtilsName(const VkBuffer& buffer, const std::string& name) const;
         void setDebugUtilsName(const VkCommandBuffer& cmdBuffer, const std::string& name) const;
@@ -17,14 +17,22 @@ namespace carbon {
         VkFence handle = nullptr;
 
     public:
+        static constexpr uint64_t defaultTimeout = 100000000000;
+
         explicit Fence(std::shared_ptr<carbon::Device> device, std::string name = {});
         Fence(const Fence& fence);
 
         void create(VkFenceCreateFlags flags = 0);
         void destroy() const;
-        void wait();
+        /** Waits for the fence to signal. Throws if the timeout in nanoseconds elapses first. */
+        void wait(uint64_t timeout = defaultTimeout);
+        /** Waits for the fence to signal. Returns false if the timeout in nanoseconds elapsed first. */
+        [[nodiscard]] bool tryWait(uint64_t timeout);
         void reset();
 
+        /** Checks whether the fence is signaled without blocking. */
+        [[nodiscard]] bool isSignaled() const;
+
         operator VkFence() const;
     };
 } // namespace carbon
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <carbon/vulkan.hpp>
+
+namespace carbon {
+    class Device;
+    class Fence;
+    class Queue;
+
+    struct FencePoolStatistics {
+        uint64_t createdFences = 0;
+        uint64_t acquiredFences = 0;
+        uint64_t releasedFences = 0;
+        /** The number of vkResetFences calls, each of which resets every released fence at once. */
+        uint64_t resetBatches = 0;
+    };
+
+    // The FencePool hands out unsignaled fences and takes them back once their submission has
+    // completed, so that transient fences, e.g. for uploads or readbacks, do not create and
+    // destroy a driver object every time. Released fences are reset in batches with a single
+    // vkResetFences, right before they are needed again. This is thread safe.
+    class FencePool {
+        std::shared_ptr<carbon::Device> device;
+        const std::string name;
+
+        std::mutex mutex;
+        std::vector<std::unique_ptr<carbon::Fence>> fences = {};
+        std::vector<carbon::Fence*> freeFences = {};
+        std::vector<carbon::Fence*> releasedFences = {};
+        // Fences whose submission has completed on the queue's timeline. The fence is signaled
+        // after the timeline though, so these are only reset once they are signaled themselves.
+        std::vector<carbon::Fence*> retiredFences = {};
+        // Reused for the handles passed to vkResetFences.
+        std::vector<VkFence> resetHandles = {};
+        carbon::FencePoolStatistics statistics = {};
+
+        void createFence();
+        void resetReleasedFences();
+
+    public:
+        explicit FencePool(std::shared_ptr<carbon::Device> device, std::string name = "fencePool");
+        FencePool(const FencePool& pool) = delete;
+        ~FencePool();
+
+        /** Creates initialCount fences up front. */
+        void create(uint32_t initialCount = 0);
+        /**
+         * Destroys every fence of the pool, which may no longer be in use. Fences retired on the
+         * device have to be flushed with Device::flushRetired before.
+         */
+        void destroy();
+
+        /** Gets an unsignaled fence, creating a new one if every fence is in use. */
+        [[nodiscard]] auto acquire() -> carbon::Fence*;
+        /** Returns a fence to the pool. It may not be part of a pending submission anymore. */
+        void release(carbon::Fence* fence);
+        /**
+         * Returns the fence to the pool through the device's retirement queue, once the submission
+         * of the queue with the given timeline value has completed. The fence is only reused once
+         * it has been signaled itself.
+         */
+        void retire(carbon::Fence* fence, const carbon::Queue* queue, uint64_t value);
+
+        [[nodiscard]] auto getStatistics() -> carbon::FencePoolStatistics;
+    };
+} // namespace carbon
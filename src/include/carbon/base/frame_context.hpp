@@ -0,0 +1,113 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <carbon/vulkan.hpp>
+
+namespace carbon {
+    class CommandBuffer;
+    class CommandPoolManager;
+    class Device;
+    class Fence;
+    class Queue;
+    class RingBuffer;
+    class Semaphore;
+    class Swapchain;
+    class SwapchainImage;
+
+    /** Everything a single frame records into, as handed out by FrameContext::beginFrame. */
+    struct Frame {
+        /** The frame-in-flight slot, in the range [0, framesInFlight). */
+        uint32_t index = 0;
+        uint32_t imageIndex = 0;
+        carbon::SwapchainImage* image = nullptr;
+        /** The primary command buffer of this frame, already begun on thread slot 0 of the pools. */
+        carbon::CommandBuffer* cmdBuffer = nullptr;
+        carbon::RingBuffer* ringBuffer = nullptr;
+    };
+
+    /** Returns the current extent of the window, or a zero extent if it is minimized. */
+    using WindowExtentFunction = std::function<VkExtent2D()>;
+    /** Called after the swapchain has been recreated, so that size-dependent resources can follow. */
+    using SwapchainRecreateFunction = std::function<void(carbon::Swapchain* swapchain)>;
+
+    // The FrameContext runs the acquire, record, submit and present loop with a fixed number
+    // of frames in flight. Every frame slot owns its acquire semaphore, fence, command pools and
+    // ring buffer, so the CPU only blocks once it is framesInFlight frames ahead of the GPU. The
+    // semaphores signaled for presentation belong to the swapchain images instead, as they may
+    // only be reused once that image has been acquired again. Out of date or suboptimal swapchains
+    // are recreated transparently.
+    class FrameContext {
+        struct FrameSlot {
+            std::unique_ptr<carbon::Fence> fence;
+            std::shared_ptr<carbon::Semaphore> imageAvailable;
+            std::unique_ptr<carbon::RingBuffer> ringBuffer;
+        };
+
+        std::shared_ptr<carbon::Device> device;
+        VmaAllocator allocator = nullptr;
+        carbon::Swapchain* swapchain = nullptr;
+        std::shared_ptr<carbon::Queue> queue;
+        const std::string name;
+
+        VkSurfaceKHR surface = nullptr;
+        carbon::WindowExtentFunction windowExtentFunction;
+        carbon::SwapchainRecreateFunction recreateFunction;
+
+        std::unique_ptr<carbon::CommandPoolManager> poolManager;
+        std::vector<FrameSlot> slots = {};
+        // Indexed by the swapchain image index.
+        std::vector<std::shared_ptr<carbon::Semaphore>> renderFinished = {};
+        // The fence of the frame which last rendered to each swapchain image.
+        std::vector<carbon::Fence*> imageFences = {};
+
+        carbon::Frame currentFrame = {};
+        uint64_t frameCount = 0;
+        uint64_t lastSubmittedValue = 0;
+        bool recording = false;
+        bool needsRecreate = false;
+
+        void createRenderFinishedSemaphores();
+        void destroyRenderFinishedSemaphores();
+        /** Returns false if the window is minimized and no swapchain can be created. */
+        bool recreateSwapchain();
+
+    public:
+        explicit FrameContext(std::shared_ptr<carbon::Device> device, VmaAllocator allocator, carbon::Swapchain* swapchain,
+                              std::shared_ptr<carbon::Queue> queue, std::string name = "frameContext");
+        ~FrameContext();
+
+        /**
+         * Creates the per-frame objects. The swapchain has to be created already. threadCount
+         * command pools are created per frame, so that a ParallelRecorder can use the pool manager.
+         */
+        void create(VkSurfaceKHR surface, carbon::WindowExtentFunction windowExtent, uint32_t framesInFlight = 2,
+                    VkDeviceSize ringBufferSize = 4 * 1024 * 1024, uint32_t threadCount = 1);
+        /** Waits for every frame in flight and destroys all per-frame objects. */
+        void destroy();
+
+        /**
+         * Waits until the next frame slot is free, acquires a swapchain image and begins the
+         * frame's command buffer. Also destroys the objects retired on the device whose
+         * submissions have completed. Returns nullptr if no frame can be rendered right now,
+         * e.g. because the window is minimized.
+         */
+        [[nodiscard]] auto beginFrame() -> carbon::Frame*;
+        /**
+         * Ends and submits the frame's command buffer and presents its image. Returns the
+         * timeline value of the submission, which can be used to retire objects used by it.
+         */
+        auto endFrame() -> uint64_t;
+
+        void setRecreateCallback(carbon::SwapchainRecreateFunction callback);
+
+        [[nodiscard]] auto getCommandPoolManager() const -> carbon::CommandPoolManager*;
+        /** Gets the number of frames which have been submitted so far. */
+        [[nodiscard]] auto getFrameCount() const -> uint64_t;
+        [[nodiscard]] auto getFramesInFlight() const -> uint32_t;
+        [[nodiscard]] auto getLastSubmittedValue() const -> uint64_t;
+    };
+} // namespace carbon
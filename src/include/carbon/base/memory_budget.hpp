@@ -0,0 +1,93 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <carbon/vulkan.hpp>
+
+namespace carbon {
+    struct HeapBudget {
+        VkMemoryHeapFlags flags = 0;
+        VkDeviceSize heapSize = 0;
+        /** Memory used by this process, including memory not allocated through VMA. */
+        VkDeviceSize usage = 0;
+        /** Estimated amount of memory available to this process. */
+        VkDeviceSize budget = 0;
+        VkDeviceSize blockBytes = 0;
+        VkDeviceSize allocationBytes = 0;
+    };
+
+    /**
+     * Called when memory has to be freed. Returns the amount of bytes that
+     * were released, which may be 0 if the resource is currently in use.
+     */
+    using EvictionCallback = std::function<VkDeviceSize()>;
+
+    // The MemoryBudget polls VMA's heap budgets, which are backed by VK_EXT_memory_budget if
+    // available, and attributes allocations to the names of the resources owning them. Owners
+    // can register evictable resources with a priority, which the budget evicts, lowest
+    // priority first, whenever a heap runs over its budget or an allocation fails.
+    class MemoryBudget {
+        struct TrackedAllocation {
+            std::string name;
+            VkDeviceSize size = 0;
+            uint32_t heapIndex = 0;
+        };
+
+        struct Evictable {
+            uint64_t id = 0;
+            std::string name;
+            uint32_t priority = 0;
+            uint32_t heapIndex = VK_MAX_MEMORY_HEAPS;
+            carbon::EvictionCallback callback;
+        };
+
+        VmaAllocator allocator = nullptr;
+        const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+
+        mutable std::mutex budgetMutex;
+        std::vector<carbon::HeapBudget> heaps = {};
+        std::unordered_map<VmaAllocation, TrackedAllocation> allocations = {};
+        std::map<std::string, VkDeviceSize> attributedUsage = {};
+        std::vector<Evictable> evictables = {};
+        uint64_t nextEvictableId = 1;
+
+    public:
+        explicit MemoryBudget(VmaAllocator allocator);
+
+        /**
+         * Refreshes the budgets of every heap. This should be called once per frame. If a heap
+         * is over its budget, evictables are asked to free memory until it fits again.
+         */
+        void update(uint32_t frameIndex);
+
+        [[nodiscard]] auto getHeapCount() const -> uint32_t;
+        [[nodiscard]] auto getHeapBudget(uint32_t heapIndex) const -> carbon::HeapBudget;
+        /** Gets the index of the first heap with a memory type that has all of the given properties. */
+        [[nodiscard]] auto getHeapIndex(VkMemoryPropertyFlags properties) const -> uint32_t;
+        /** Gets the amount of memory currently allocated per resource name. */
+        [[nodiscard]] auto getAttributedUsage() const -> std::map<std::string, VkDeviceSize>;
+
+        void trackAllocation(VmaAllocation allocation, const std::string& name);
+        void untrackAllocation(VmaAllocation allocation);
+
+        /**
+         * Registers an evictable resource. Lower priorities get evicted first. If heapIndex
+         * is VK_MAX_MEMORY_HEAPS, the resource is considered for every heap.
+         */
+        auto registerEvictable(std::string name, uint32_t priority, carbon::EvictionCallback callback,
+                               uint32_t heapIndex = VK_MAX_MEMORY_HEAPS) -> uint64_t;
+        void unregisterEvictable(uint64_t id);
+
+        /**
+         * Evicts resources until the given amount of bytes is available in the heap. Returns
+         * false if not enough memory could be freed. The callbacks are called without holding
+         * any lock, so they are free to destroy their resources.
+         */
+        bool ensureAvailable(uint32_t heapIndex, VkDeviceSize bytes);
+    };
+} // namespace carbon
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <carbon/vulkan.hpp>
+
+namespace carbon {
+    class CommandBuffer;
+    class CommandPoolManager;
+    class ThreadPool;
+
+    /** Records the draws in the range [begin, end) into the given secondary command buffer. */
+    using RecordFunction = std::function<void(carbon::CommandBuffer* cmdBuffer, size_t begin, size_t end)>;
+
+    // The ParallelRecorder splits a draw list into contiguous ranges, records each range into
+    // its own secondary command buffer on a worker thread, and executes the secondary buffers
+    // in the primary buffer in order. The primary buffer has to be inside a dynamic rendering
+    // instance begun with VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT.
+    class ParallelRecorder {
+        carbon::ThreadPool* threadPool = nullptr;
+        carbon::CommandPoolManager* poolManager = nullptr;
+
+        std::vector<VkCommandBuffer> secondaryHandles = {};
+
+    public:
+        // Splitting into ranges smaller than this costs more than it saves.
+        static constexpr size_t minDrawsPerThread = 64;
+
+        explicit ParallelRecorder(carbon::ThreadPool* threadPool, carbon::CommandPoolManager* poolManager);
+
+        /**
+         * Records drawCount draws using up to threadCount threads, which defaults to the number
+         * of threads the pool manager has pools for. Thread i records into the pools of thread
+         * slot i of the given frame, so no other thread may use those slots in the meantime.
+         */
+        void record(carbon::CommandBuffer* primary, uint32_t frameIndex, const VkCommandBufferInheritanceRenderingInfo& renderingInfo,
+                    size_t drawCount, const carbon::RecordFunction& recordFunction, uint32_t threadCount = 0);
+    };
+} // namespace carbon
@@ -36,6 +36,7 @@ namespace carbon {
         [[nodiscard]] auto getDeviceName() const -> std::string_view;
         [[nodiscard]] auto getProperties(void* pNext) const -> VkPhysicalDeviceProperties2;
         [[nodiscard]] auto getMemoryProperties(void* pNext) const -> VkPhysicalDeviceMemoryProperties2*;
+        [[nodiscard]] auto getQueueFamilyFlags(uint32_t queueFamilyIndex) const -> VkQueueFlags;
         [[nodiscard]] bool supportsExtension(const char* extension);
 
         operator VkPhysicalDevice() const;
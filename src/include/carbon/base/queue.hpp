@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <mutex>
+#include <vector>
 
 #include <carbon/vulkan.hpp>
 
@@ -10,20 +11,44 @@ namespace carbon {
     class Device;
     class Fence;
     class Semaphore;
+    class TimelineSemaphore;
+    class Queue;
+    class QueueSubmission;
+
+    /** A dependency on the submission of another queue which signaled the given timeline value. */
+    struct TimelineWait {
+        const carbon::Queue* queue = nullptr;
+        uint64_t value = 0;
+        VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    };
 
     class Queue {
+        friend class carbon::QueueSubmission;
+
         std::shared_ptr<carbon::Device> device;
 
         const std::string name;
 
         VkQueue handle = nullptr;
-        mutable std::mutex queueMutex = {};
+        uint32_t familyIndex = 0;
+        // Shared with every other carbon::Queue wrapping the same VkQueue.
+        std::shared_ptr<std::mutex> queueMutex;
+
+        // Every tracked submission signals the next value on this timeline. Copies of this queue
+        // share the timeline and therefore also the last signaled value, which is guarded by
+        // queueMutex, so that no two copies ever signal the same value.
+        std::shared_ptr<carbon::TimelineSemaphore> timeline;
+        std::shared_ptr<uint64_t> lastSubmittedValue;
 
     public:
         explicit Queue(std::shared_ptr<carbon::Device> device, std::string name = {});
         Queue(const carbon::Queue& queue);
 
-        /** Get's the device's VkQueue */
+        /**
+         * Gets the device's best VkQueue of the given type. Compute and transfer queues use a
+         * dedicated or separate queue family if there is one and fall back to the graphics queue
+         * otherwise, which can be checked by comparing the family indices.
+         */
         void create(vkb::QueueType queueType = vkb::QueueType::graphics);
         void destroy() const;
         void lock() const;
@@ -31,9 +56,29 @@ namespace carbon {
         void waitIdle() const;
 
         [[nodiscard]] auto getCheckpointData(uint32_t queryCount) const -> std::vector<VkCheckpointDataNV>;
+        /** Gets the timeline value of the most recent submission which has completed on the GPU. */
+        [[nodiscard]] auto getCompletedValue() const -> uint64_t;
+        [[nodiscard]] auto getFamilyIndex() const -> uint32_t;
+        [[nodiscard]] auto getLastSubmittedValue() const -> uint64_t;
         /** Creates a new unique_lock, which will automatically lock the mutex. */
         [[nodiscard]] auto getLock() const -> std::unique_lock<std::mutex>;
+        [[nodiscard]] auto getTimelineSemaphore() const -> carbon::TimelineSemaphore*;
+        /** Checks whether the submission with the given timeline value has completed, without blocking. */
+        [[nodiscard]] bool isComplete(uint64_t value) const;
         [[nodiscard]] auto submit(carbon::Fence* fence, const VkSubmitInfo* submitInfo) const -> VkResult;
+        /**
+         * Submits and additionally signals the queue's timeline with a new value, which is
+         * returned. Unlike the fence overload, this locks the queue itself, so that the values
+         * are signaled in submission order. The submit info must not already chain a
+         * VkTimelineSemaphoreSubmitInfo; timeline waits on other queues are passed as waits.
+         */
+        auto submit(const VkSubmitInfo* submitInfo, carbon::Fence* fence = nullptr, const std::vector<carbon::TimelineWait>& waits = {})
+            -> uint64_t;
+        /**
+         * Blocks until the submission with the given timeline value has completed or the
+         * timeout in nanoseconds elapses. Returns false if the timeout elapsed first.
+         */
+        bool wait(uint64_t value, uint64_t timeout = UINT64_MAX) const;
         [[nodiscard]] auto present(uint32_t imageIndex, const VkSwapchainKHR& swapchain,
                                    std::shared_ptr<carbon::Semaphore> waitSemaphore) const -> VkResult;
 
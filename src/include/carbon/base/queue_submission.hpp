@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include <carbon/vulkan.hpp>
+
+namespace carbon {
+    class CommandBuffer;
+    class Fence;
+    class Queue;
+    class Semaphore;
+    class TimelineSemaphore;
+    struct TimelineWait;
+
+    // A QueueSubmission gathers command buffers and semaphore operations of possibly several
+    // batches and submits all of them with a single vkQueueSubmit2 call, as every submit call
+    // has a noticeable fixed cost in the driver. Batches execute in the order they were
+    // added; a new batch is only needed when a later set of command buffers has to wait on
+    // semaphores the earlier ones do not. The last batch additionally signals the queue's
+    // timeline, so the whole submission can be tracked with the returned value.
+    class QueueSubmission {
+        struct Batch {
+            std::vector<VkSemaphoreSubmitInfo> waitInfos = {};
+            std::vector<VkCommandBufferSubmitInfo> cmdBufferInfos = {};
+            std::vector<VkSemaphoreSubmitInfo> signalInfos = {};
+        };
+
+        carbon::Queue* queue = nullptr;
+        std::vector<Batch> batches = { {} };
+
+    public:
+        explicit QueueSubmission(carbon::Queue* queue);
+
+        auto addCommandBuffer(const carbon::CommandBuffer* cmdBuffer) -> QueueSubmission&;
+        auto addCommandBuffer(VkCommandBuffer cmdBuffer) -> QueueSubmission&;
+        /** Starts a new batch. Empty batches are not submitted. */
+        auto nextBatch() -> QueueSubmission&;
+
+        auto signal(const carbon::Semaphore& semaphore, VkPipelineStageFlags2 stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT)
+            -> QueueSubmission&;
+        auto signal(const carbon::TimelineSemaphore& semaphore, uint64_t value,
+                    VkPipelineStageFlags2 stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT) -> QueueSubmission&;
+        auto wait(const carbon::Semaphore& semaphore, VkPipelineStageFlags2 stageMask) -> QueueSubmission&;
+        auto wait(const carbon::TimelineSemaphore& semaphore, uint64_t value, VkPipelineStageFlags2 stageMask) -> QueueSubmission&;
+        /** Waits for a submission of another queue, identified by its timeline value. */
+        auto wait(const carbon::TimelineWait& timelineWait) -> QueueSubmission&;
+
+        /**
+         * Submits all batches with a single call while holding the queue's lock, and clears the
+         * submission so that it can be reused. The fence, if given, signals once every batch has
+         * completed. Returns the timeline value signaled by the last batch.
+         */
+        auto submit(carbon::Fence* fence = nullptr) -> uint64_t;
+    };
+} // namespace carbon
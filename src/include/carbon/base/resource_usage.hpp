@@ -0,0 +1,60 @@
+#pragma once
+
+#include <carbon/vulkan.hpp>
+
+namespace carbon {
+    /** Describes how a resource is accessed by a command. Barriers are derived from a pair of these. */
+    enum class ResourceUsage : uint32_t {
+        /** The previous contents are not needed. Only valid as the source of a barrier. */
+        Undefined,
+        IndexBuffer,
+        VertexBuffer,
+        IndirectBuffer,
+        UniformBuffer,
+        SampledRead,
+        StorageRead,
+        StorageWrite,
+        StorageReadWrite,
+        ColorAttachment,
+        DepthStencilAttachment,
+        DepthStencilRead,
+        TransferSrc,
+        TransferDst,
+        /** Vertex, index, transform or instance data read by an acceleration structure build. */
+        AccelerationStructureBuildInput,
+        AccelerationStructureBuild,
+        AccelerationStructureRead,
+        HostRead,
+        HostWrite,
+        Present,
+    };
+
+    // Only writes have to be made available by a barrier. Reads just need an execution dependency.
+    constexpr VkAccessFlags2 writeAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+                                               VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT |
+                                               VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR | VK_ACCESS_2_HOST_WRITE_BIT |
+                                               VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+    struct ResourceUsageInfo {
+        VkPipelineStageFlags2 stageMask = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 accessMask = VK_ACCESS_2_NONE;
+        /** The layout an image has to be in for this usage. */
+        VkImageLayout imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    /** The stages and accesses which barriers may use on a queue. Everything is supported by default. */
+    struct SupportedUsage {
+        VkPipelineStageFlags2 stageMask = ~VkPipelineStageFlags2(0);
+        VkAccessFlags2 accessMask = ~VkAccessFlags2(0);
+    };
+
+    [[nodiscard]] auto getResourceUsageInfo(carbon::ResourceUsage usage) -> carbon::ResourceUsageInfo;
+    /** Gets the stages and accesses supported by queues of a family with the given capabilities. */
+    [[nodiscard]] auto getSupportedUsage(VkQueueFlags queueFlags) -> carbon::SupportedUsage;
+    /**
+     * Removes the stages and accesses a queue does not support from a usage. Usages which are
+     * shared between pipeline types, e.g. the shader stages, are still valid afterwards.
+     */
+    [[nodiscard]] auto maskResourceUsageInfo(const carbon::ResourceUsageInfo& info, const carbon::SupportedUsage& supported)
+        -> carbon::ResourceUsageInfo;
+} // namespace carbon
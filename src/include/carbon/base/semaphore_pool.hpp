@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace carbon {
+    class Device;
+    class Queue;
+    class Semaphore;
+
+    struct SemaphorePoolStatistics {
+        uint64_t createdSemaphores = 0;
+        uint64_t acquiredSemaphores = 0;
+        uint64_t releasedSemaphores = 0;
+    };
+
+    // The SemaphorePool recycles binary semaphores. A binary semaphore can be reused as soon as
+    // the submission which waited on it has completed, which is when it should be released or
+    // retired. This is thread safe.
+    class SemaphorePool {
+        std::shared_ptr<carbon::Device> device;
+        const std::string name;
+
+        std::mutex mutex;
+        std::vector<std::shared_ptr<carbon::Semaphore>> semaphores = {};
+        std::vector<std::shared_ptr<carbon::Semaphore>> freeSemaphores = {};
+        carbon::SemaphorePoolStatistics statistics = {};
+
+        void createSemaphore();
+
+    public:
+        explicit SemaphorePool(std::shared_ptr<carbon::Device> device, std::string name = "semaphorePool");
+        SemaphorePool(const SemaphorePool& pool) = delete;
+        ~SemaphorePool();
+
+        /** Creates initialCount semaphores up front. */
+        void create(uint32_t initialCount = 0);
+        /**
+         * Destroys every semaphore of the pool, which may no longer be in use. Semaphores retired
+         * on the device have to be flushed with Device::flushRetired before.
+         */
+        void destroy();
+
+        /** Gets an unsignaled binary semaphore, creating a new one if every semaphore is in use. */
+        [[nodiscard]] auto acquire() -> std::shared_ptr<carbon::Semaphore>;
+        /** Returns a semaphore to the pool. It may neither be signaled nor be waited on anymore. */
+        void release(std::shared_ptr<carbon::Semaphore> semaphore);
+        /**
+         * Returns the semaphore to the pool through the device's retirement queue, once the
+         * submission of the queue with the given timeline value, which waited on it, has completed.
+         */
+        void retire(std::shared_ptr<carbon::Semaphore> semaphore, const carbon::Queue* queue, uint64_t value);
+
+        [[nodiscard]] auto getStatistics() -> carbon::SemaphorePoolStatistics;
+    };
+} // namespace carbon
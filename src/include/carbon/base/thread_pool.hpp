@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace carbon {
+    // A simple fixed-size pool of worker threads which execute tasks in FIFO order.
+    class ThreadPool {
+        std::vector<std::thread> workers = {};
+        std::queue<std::function<void()>> tasks = {};
+
+        std::mutex taskMutex;
+        std::condition_variable taskCondition;
+        bool stopping = false;
+
+        void work();
+
+    public:
+        explicit ThreadPool(uint32_t threadCount = std::max(1U, std::thread::hardware_concurrency()));
+        ThreadPool(const ThreadPool& pool) = delete;
+        /** Finishes all queued tasks and joins every worker. */
+        ~ThreadPool();
+
+        void enqueue(std::function<void()> task);
+
+        template <typename F>
+        auto submit(F&& function) -> std::future<std::invoke_result_t<F>> {
+            // std::function requires copyable callables, which packaged_task is not.
+            auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(function));
+            auto future = task->get_future();
+            enqueue([task]() { (*task)(); });
+            return future;
+        }
+
+        [[nodiscard]] auto getThreadCount() const -> uint32_t;
+    };
+} // namespace carbon
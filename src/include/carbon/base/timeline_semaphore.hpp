@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <carbon/vulkan.hpp>
+
+namespace carbon {
+    class Device;
+
+    // A timeline semaphore carries a monotonically increasing 64-bit value instead of a binary
+    // state. A single timeline can therefore track any number of submissions: each submission
+    // signals a higher value and everything up to the current counter value is known to be
+    // complete, without having to create, wait on and reset a fence per submission.
+    class TimelineSemaphore {
+        std::shared_ptr<carbon::Device> device;
+        const std::string name;
+
+        VkSemaphore handle = nullptr;
+
+    public:
+        explicit TimelineSemaphore(std::shared_ptr<carbon::Device> device, std::string name = {});
+        TimelineSemaphore(const TimelineSemaphore& semaphore) = default;
+
+        void create(uint64_t initialValue = 0);
+        void destroy() const;
+
+        /** Gets the current counter value. Every signal operation up to this value has completed. */
+        [[nodiscard]] auto getCompletedValue() const -> uint64_t;
+        [[nodiscard]] auto getHandle() const -> const VkSemaphore&;
+        /** Checks whether the counter has reached the given value without blocking. */
+        [[nodiscard]] bool isComplete(uint64_t value) const;
+
+        /** Signals the given value from the host. It has to be greater than the current value. */
+        void signal(uint64_t value) const;
+
+        /**
+         * Blocks until the counter reaches the given value or the timeout in nanoseconds
+         * elapses. Returns false if the timeout elapsed first.
+         */
+        bool wait(uint64_t value, uint64_t timeout = UINT64_MAX) const;
+
+        operator VkSemaphore() const;
+    };
+} // namespace carbon
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <carbon/base/resource_usage.hpp>
+#include <carbon/vulkan.hpp>
+
+namespace carbon {
+    class Buffer;
+    class CommandBuffer;
+    class Device;
+    class Image;
+    class RenderGraph;
+
+    /** Identifies an image or buffer within a single RenderGraph. */
+    using GraphResource = uint32_t;
+
+    using GraphExecuteFunction = std::function<void(carbon::CommandBuffer* cmdBuffer, const carbon::RenderGraph& graph)>;
+
+    struct TransientImageInfo {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent = { 0, 0 };
+        VkImageUsageFlags usage = 0;
+    };
+
+    struct TransientBufferInfo {
+        VkDeviceSize size = 0;
+        VkBufferUsageFlags usage = 0;
+    };
+
+    struct RenderGraphStatistics {
+        uint32_t passCount = 0;
+        uint32_t culledPassCount = 0;
+        uint32_t barrierCount = 0;
+        /** The memory used by all transient resources. */
+        VkDeviceSize transientMemorySize = 0;
+        /** The memory the transient resources would need if none of them were aliased. */
+        VkDeviceSize unaliasedMemorySize = 0;
+    };
+
+    class GraphPass {
+        friend class carbon::RenderGraph;
+
+        struct Access {
+            carbon::GraphResource resource = 0;
+            carbon::ResourceUsage usage = carbon::ResourceUsage::Undefined;
+            bool write = false;
+        };
+
+        std::string name;
+        carbon::GraphExecuteFunction execute;
+        std::vector<Access> accesses = {};
+        bool sideEffects = false;
+
+    public:
+        explicit GraphPass(std::string name, carbon::GraphExecuteFunction execute);
+
+        auto read(carbon::GraphResource resource, carbon::ResourceUsage usage) -> GraphPass&;
+        /**
+         * Declares a write to the resource. The previous contents are discarded, unless the pass
+         * also declares a read of the resource.
+         */
+        auto write(carbon::GraphResource resource, carbon::ResourceUsage usage) -> GraphPass&;
+        /** Marks the pass as having effects outside of the graph, so that it is never culled. */
+        auto setSideEffects() -> GraphPass&;
+    };
+
+    // The RenderGraph orders the work of a frame as a list of passes which declare the
+    // resources they read and write. Compiling the graph culls every pass whose results are
+    // never used, computes the barriers and layout transitions between the passes, and places
+    // transient resources whose lifetimes do not overlap in the same memory. The graph is meant
+    // to be built and compiled once and then executed every frame; it has to be reset and
+    // compiled again whenever the passes change.
+    class RenderGraph {
+        struct Resource {
+            std::string name;
+            bool isImage = false;
+
+            // Imported resources are owned by the caller and keep their contents across frames.
+            carbon::Image* importedImage = nullptr;
+            carbon::Buffer* importedBuffer = nullptr;
+            carbon::ResourceUsage initialUsage = carbon::ResourceUsage::Undefined;
+            carbon::ResourceUsage finalUsage = carbon::ResourceUsage::Undefined;
+
+            carbon::TransientImageInfo imageInfo = {};
+            carbon::TransientBufferInfo bufferInfo = {};
+
+            VkImage image = nullptr;
+            VkImageView imageView = nullptr;
+            VkBuffer buffer = nullptr;
+            VkMemoryRequirements memoryRequirements = {};
+            VkDeviceSize memoryOffset = 0;
+            /** Whether the memory is shared with another resource, which may have used it earlier in this or the previous frame. */
+            bool aliased = false;
+            /** The layout an imported image is left in after the graph executed. */
+            VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            // The range of compiled passes the resource is used in.
+            uint32_t firstPass = UINT32_MAX;
+            uint32_t lastPass = 0;
+
+            [[nodiscard]] bool isImported() const { return importedImage != nullptr || importedBuffer != nullptr; }
+        };
+
+        struct Barrier {
+            carbon::GraphResource resource = 0;
+            carbon::ResourceUsageInfo src = {};
+            carbon::ResourceUsageInfo dst = {};
+        };
+
+        struct CompiledPass {
+            uint32_t pass = 0;
+            std::vector<Barrier> barriers = {};
+        };
+
+        std::shared_ptr<carbon::Device> device;
+        VmaAllocator allocator = nullptr;
+        const std::string name;
+
+        // A deque keeps references returned by addPass valid.
+        std::deque<carbon::GraphPass> passes = {};
+        std::vector<Resource> resources = {};
+
+        std::vector<CompiledPass> compiledPasses = {};
+        std::vector<Barrier> finalBarriers = {};
+        std::vector<VmaAllocation> transientAllocations = {};
+        carbon::RenderGraphStatistics statistics = {};
+
+        void cullPasses();
+        void createTransientResources();
+        /** Places all used transient images or buffers in a single allocation, aliasing them where possible. */
+        void placeTransientResources(bool images);
+        void computeBarriers();
+        void destroyTransientResources();
+
+        [[nodiscard]] auto getSubresourceRange(const Resource& resource) const -> VkImageSubresourceRange;
+        void recordBarrier(carbon::CommandBuffer* cmdBuffer, const Barrier& barrier) const;
+
+    public:
+        explicit RenderGraph(std::shared_ptr<carbon::Device> device, VmaAllocator allocator, std::string name = "renderGraph");
+        ~RenderGraph();
+
+        /**
+         * Adds a pass which is executed after all previously added passes. The returned pass
+         * is used to declare the resources it accesses.
+         */
+        auto addPass(std::string passName, carbon::GraphExecuteFunction execute) -> carbon::GraphPass&;
+        auto createBuffer(std::string bufferName, const carbon::TransientBufferInfo& info) -> carbon::GraphResource;
+        auto createImage(std::string imageName, const carbon::TransientImageInfo& info) -> carbon::GraphResource;
+        /**
+         * Imports a resource owned by the caller. It is expected to be in initialUsage when the
+         * graph executes and is transitioned to finalUsage at the end, unless that is Undefined.
+         * Passes writing to imported resources are never culled.
+         */
+        auto importBuffer(carbon::Buffer* buffer, carbon::ResourceUsage initialUsage,
+                          carbon::ResourceUsage finalUsage = carbon::ResourceUsage::Undefined) -> carbon::GraphResource;
+        auto importImage(carbon::Image* image, carbon::ResourceUsage initialUsage,
+                         carbon::ResourceUsage finalUsage = carbon::ResourceUsage::Undefined) -> carbon::GraphResource;
+
+        void compile();
+        /** Records every remaining pass together with the barriers it needs into the command buffer. */
+        void execute(carbon::CommandBuffer* cmdBuffer) const;
+        /** Removes all passes and resources. The GPU must no longer use any transient resource. */
+        void reset();
+        void destroy();
+
+        [[nodiscard]] auto getBuffer(carbon::GraphResource resource) const -> VkBuffer;
+        [[nodiscard]] auto getImage(carbon::GraphResource resource) const -> VkImage;
+        [[nodiscard]] auto getImageView(carbon::GraphResource resource) const -> VkImageView;
+        [[nodiscard]] auto getStatistics() const -> const carbon::RenderGraphStatistics&;
+    };
+} // namespace carbon
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <carbon/pipeline/pipeline.hpp>
+
+namespace carbon {
+    class Device;
+    class ShaderModule;
+
+    /**
+     * A compute pipeline, made of a single compute shader.
+     */
+    class ComputePipeline final : public carbon::Pipeline {
+        VkPipelineShaderStageCreateInfo shaderStage = {};
+
+    public:
+        explicit ComputePipeline(carbon::Device* device);
+
+        void create() override;
+        [[nodiscard]] auto getBindPoint() const noexcept -> VkPipelineBindPoint override;
+        void setName(const std::string&) noexcept override;
+        void setShaderModule(carbon::ShaderModule* shader);
+    };
+} // namespace carbon
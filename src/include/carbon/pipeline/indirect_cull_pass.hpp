@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <memory>
+
+#include <carbon/vulkan.hpp>
+
+namespace carbon {
+    class Buffer;
+    class CommandBuffer;
+    class ComputePipeline;
+    class Device;
+    class IndirectBuffer;
+    class ShaderModule;
+
+    /** A single object to be culled, as laid out in the instance buffer of the IndirectCullPass. */
+    struct CullInstance {
+        /** The world space center in xyz and the radius in w. */
+        std::array<float, 4> boundingSphere = {};
+        uint32_t indexCount = 0;
+        uint32_t firstIndex = 0;
+        int32_t vertexOffset = 0;
+        /** Passed as firstInstance, so that the vertex shader can find its data through gl_InstanceIndex. */
+        uint32_t instanceIndex = 0;
+    };
+
+    /** The six world space frustum planes as (normal, distance), with the normals pointing inwards. */
+    using FrustumPlanes = std::array<std::array<float, 4>, 6>;
+
+    // The IndirectCullPass tests the bounding sphere of every instance against the view frustum
+    // on the GPU, and appends a draw for each visible instance to an IndirectBuffer. The CPU cost
+    // of the draw submission therefore stays the same regardless of the object count. As carbon
+    // does not compile shaders, the pass is created with a module compiled from shaderSource.
+    // The buffers are accessed through their device addresses, so they need to have been created
+    // with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT.
+    class IndirectCullPass {
+        struct PushConstants {
+            VkDeviceAddress instances = 0;
+            VkDeviceAddress output = 0;
+            carbon::FrustumPlanes frustumPlanes = {};
+            uint32_t instanceCount = 0;
+            uint32_t maxDrawCount = 0;
+        };
+
+        std::shared_ptr<carbon::Device> device;
+        std::unique_ptr<carbon::ComputePipeline> pipeline;
+
+    public:
+        static constexpr uint32_t workgroupSize = 64;
+        /** The GLSL source of the culling compute shader. */
+        static const char* const shaderSource;
+
+        explicit IndirectCullPass(std::shared_ptr<carbon::Device> device);
+        ~IndirectCullPass();
+
+        /** Throws if the device does not support VK_KHR_draw_indirect_count, which drawing the output requires. */
+        void create(carbon::ShaderModule* shader);
+        void destroy();
+
+        /**
+         * Records the culling of instanceCount instances into the output buffer, which has to be
+         * a device local IndirectBuffer. The instance buffer has to be readable by compute shaders
+         * already. Afterwards, the output is ready to be drawn with IndirectBuffer::draw.
+         */
+        void record(carbon::CommandBuffer* cmdBuffer, const carbon::Buffer* instances, uint32_t instanceCount,
+                    const carbon::IndirectBuffer* output, const carbon::FrustumPlanes& frustumPlanes) const;
+    };
+} // namespace carbon
@@ -9,6 +9,7 @@ namespace carbon {
     class CommandBuffer;
     class DescriptorSet;
     class Device;
+    class Queue;
 
     /**
      * A base implementation of a Vulkan pipeline.
@@ -32,6 +33,8 @@ namespace carbon {
         virtual void addPushConstant(uint32_t size, carbon::ShaderStage stages, uint32_t offset = 0);
         virtual void create() = 0;
         virtual void destroy();
+        /** Like destroy, but deferred until the given submission of the queue has completed. */
+        void retire(const carbon::Queue* queue, uint64_t value);
         [[nodiscard]] virtual auto getBindPoint() const -> VkPipelineBindPoint = 0;
         virtual void setName(const std::string&) = 0;
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <future>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -8,21 +9,23 @@
 
 namespace carbon {
     class CommandBuffer;
+    class Defragmenter;
     class Device;
     class Image;
+    class Queue;
+    class ThreadPool;
 
     /**
      * A basic data buffer, managed using vma.
      */
     class Buffer {
         friend class carbon::CommandBuffer;
+        friend class carbon::Defragmenter;
 
-        carbon::Device* device;
         std::string name;
 
         mutable std::mutex memoryMutex;
 
-        VmaAllocator allocator = nullptr;
         VmaAllocation allocation = nullptr;
 
         VkBufferUsageFlags bufferUsage = 0;
@@ -30,16 +33,29 @@ namespace carbon {
         VkMemoryPropertyFlags memoryProperties = 0;
         VmaAllocationCreateFlags allocationFlags = 0;
 
+        // Host visible memory which is not cached is usually write-combined, which is
+        // written to a lot faster using non-temporal stores.
+        bool writeCombined = false;
+
         auto getCreateInfo() const -> VkBufferCreateInfo;
+        void copyToMapped(void* destination, const void* source, uint64_t size) const;
         static auto getBufferAddressInfo(VkBuffer handle) -> VkBufferDeviceAddressInfoKHR;
         static auto getBufferDeviceAddress(carbon::Device* device, VkBufferDeviceAddressInfoKHR* addressInfo) -> VkDeviceAddress;
 
     protected:
+        carbon::Device* device;
+        VmaAllocator allocator = nullptr;
+
         VkDeviceSize size = 0;
         VkDeviceAddress address = 0;
         VkBuffer handle = nullptr;
+        // Only set if the allocation was created with VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        // in which case it stays valid for the entire lifetime of the buffer.
+        void* mappedData = nullptr;
 
     public:
+        static constexpr uint64_t parallelCopyChunkSize = 4ULL * 1024 * 1024;
+
         explicit Buffer(carbon::Device* device, VmaAllocator allocator);
         explicit Buffer(carbon::Device* device, VmaAllocator allocator, std::string name);
         Buffer(const Buffer& buffer);
@@ -63,16 +79,37 @@ namespace carbon {
         // VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT or
         // VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT was set.
         void create(VkDeviceSize newSize, VkBufferUsageFlags bufferUsage, VmaAllocationCreateFlags flags, VkMemoryPropertyFlags properties = 0);
+        /**
+         * Same as create, but returns the result instead of reporting and throwing the error, for
+         * allocations which have a fallback. The buffer stays empty if this fails.
+         */
+        [[nodiscard]] auto tryCreate(VkDeviceSize newSize, VkBufferUsageFlags bufferUsage, VmaAllocationCreateFlags flags,
+                                     VkMemoryPropertyFlags properties = 0) -> VkResult;
         virtual void destroy();
+        /**
+         * Hands the buffer to the device's retirement queue, which destroys it once the given
+         * submission of the queue has completed. The object itself can be reused right away.
+         */
+        virtual void retire(const carbon::Queue* queue, uint64_t value);
         void lock() const;
-        // Resizes the buffer to a new size. Note that this zeros the memory.
+        // Resizes the buffer to a new size. Note that this discards the contents.
         virtual void resize(VkDeviceSize newSize);
+        /**
+         * Grows the buffer to at least requiredSize bytes, doubling its capacity, while
+         * preserving its contents by recording a copy into cmdBuffer. The previous buffer is
+         * returned and has to be destroyed only once cmdBuffer has finished executing. If the
+         * buffer is already big enough, nothing happens and nullptr is returned. The buffer must
+         * have been created with VK_BUFFER_USAGE_TRANSFER_SRC_BIT and VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+         */
+        [[nodiscard]] auto grow(carbon::CommandBuffer* cmdBuffer, VkDeviceSize requiredSize) -> std::unique_ptr<carbon::Buffer>;
         void unlock() const;
 
         [[nodiscard]] virtual auto getDeviceAddress() const -> VkDeviceAddress;
         /** Gets a basic descriptor buffer info, with given size and given offset, or 0 if omitted. */
         [[nodiscard]] virtual auto getDescriptorInfo(VkDeviceSize size, VkDeviceSize offset) const -> VkDescriptorBufferInfo;
         [[nodiscard]] auto getHandle() const -> VkBuffer;
+        /** Gets the persistently mapped pointer, or nullptr if the buffer is not persistently mapped. */
+        [[nodiscard]] auto getMappedData() const -> void*;
         [[nodiscard]] auto getDeviceOrHostConstAddress() const -> const VkDeviceOrHostAddressConstKHR;
         [[nodiscard]] auto getDeviceOrHostAddress() const -> const VkDeviceOrHostAddressKHR;
         [[nodiscard]] auto getMemoryBarrier(VkAccessFlags srcAccess, VkAccessFlags dstAccess) const -> VkBufferMemoryBarrier;
@@ -83,6 +120,33 @@ namespace carbon {
          * mapped memory for this buffer.
          */
         void memoryCopy(const void* source, uint64_t size, uint64_t offset = 0) const;
+        /**
+         * Copies the memory of size from source into the mapped memory for this buffer. Only
+         * mapping the memory takes the buffer's lock, which persistently mapped buffers skip, so
+         * multiple threads may call this at the same time, as long as their ranges do not overlap.
+         */
+        void writeRange(const void* source, uint64_t size, uint64_t offset) const;
+        /**
+         * Splits a large copy into chunks which are written in parallel by the thread pool. The
+         * memory stays mapped until the returned future is ready. The source has to stay valid
+         * until then too. Small copies are done right away on the calling thread.
+         */
+        auto memoryCopy(carbon::ThreadPool* threadPool, const void* source, uint64_t size, uint64_t offset = 0) const
+            -> std::future<void>;
+
+        /**
+         * Records the release half of a queue family ownership transfer from srcQueue to
+         * dstQueue into a command buffer submitted to srcQueue. The matching acquire has to be
+         * recorded on dstQueue, which waits for the release with a semaphore. If both queues belong
+         * to the same family, the release does nothing and the acquire is a regular barrier.
+         */
+        void releaseOwnership(carbon::CommandBuffer* cmdBuffer, const carbon::Queue* srcQueue, const carbon::Queue* dstQueue,
+                              VkPipelineStageFlags srcStage, VkAccessFlags srcAccess) const;
+        void acquireOwnership(carbon::CommandBuffer* cmdBuffer, const carbon::Queue* srcQueue, const carbon::Queue* dstQueue,
+                              VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) const;
+
+        /** Makes device writes visible to the host. Required before reading memory which is not host coherent. */
+        void invalidateMemory(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
 
         void mapMemory(void** destination) const;
         void unmapMemory() const;
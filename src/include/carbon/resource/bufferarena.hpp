@@ -0,0 +1,90 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <carbon/vulkan.hpp>
+
+namespace carbon {
+    class Buffer;
+    class Device;
+
+    /** A range of one of the blocks of a BufferArena. */
+    struct BufferArenaAllocation {
+        VkBuffer buffer = nullptr;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        VkDeviceAddress deviceAddress = 0;
+        void* hostAddress = nullptr;
+
+        uint32_t blockIndex = 0;
+        VmaVirtualAllocation virtualAllocation = nullptr;
+        // The buffer of the block, which stays alive as long as this range is allocated. Keeping
+        // it here lets uploads into the range skip the arena's lock.
+        carbon::Buffer* blockBuffer = nullptr;
+
+        [[nodiscard]] auto getDeviceOrHostConstAddress() const -> VkDeviceOrHostAddressConstKHR { return { .deviceAddress = deviceAddress }; }
+        [[nodiscard]] auto getDeviceOrHostAddress() const -> VkDeviceOrHostAddressKHR { return { .deviceAddress = deviceAddress }; }
+    };
+
+    // A BufferArena creates a few large buffers and sub-allocates ranges from them using VMA's
+    // virtual blocks. Many small meshes can therefore share the same VkBuffer, which avoids
+    // creating thousands of buffer objects and rebinding buffers between draws. All ranges
+    // share the usage and memory properties given to create().
+    class BufferArena {
+        struct Block {
+            std::unique_ptr<carbon::Buffer> buffer;
+            VmaVirtualBlock virtualBlock = nullptr;
+        };
+
+        carbon::Device* device = nullptr;
+        VmaAllocator allocator = nullptr;
+        const std::string name;
+
+        VkDeviceSize blockSize = 0;
+        VkBufferUsageFlags bufferUsage = 0;
+        VmaAllocationCreateFlags allocationFlags = 0;
+        VkMemoryPropertyFlags memoryProperties = 0;
+
+        mutable std::mutex arenaMutex;
+        std::vector<Block> blocks = {};
+
+        auto createBlock(VkDeviceSize size) -> uint32_t;
+        void destroyBlock(Block& block);
+
+    public:
+        static constexpr VkDeviceSize defaultBlockSize = 64ULL * 1024 * 1024;
+
+        explicit BufferArena(carbon::Device* device, VmaAllocator allocator, std::string name = "bufferArena");
+        ~BufferArena();
+
+        /**
+         * Sets up the arena. No memory is allocated until the first range is requested.
+         * Allocations bigger than blockSize get a block of their own.
+         */
+        void create(VkBufferUsageFlags usage, VmaAllocationCreateFlags flags = 0, VkMemoryPropertyFlags properties = 0,
+                    VkDeviceSize blockSize = defaultBlockSize);
+        void destroy();
+
+        /** Allocates a new range. The alignment has to be a power of two. */
+        [[nodiscard]] auto allocate(VkDeviceSize size, VkDeviceSize alignment = 16) -> carbon::BufferArenaAllocation;
+        template <typename T>
+        [[nodiscard]] auto allocate(size_t count) -> carbon::BufferArenaAllocation {
+            return allocate(sizeof(T) * count, alignof(T));
+        }
+        void free(carbon::BufferArenaAllocation& allocation);
+
+        /** Gets the buffer the given range has been allocated from, e.g. to upload into it. This does not lock the arena. */
+        [[nodiscard]] auto getBuffer(const carbon::BufferArenaAllocation& allocation) const -> carbon::Buffer*;
+        [[nodiscard]] auto getBlockCount() const -> size_t;
+
+        /**
+         * Copies dataSize bytes into the given range. This is only valid for host visible
+         * arenas and does not synchronize, so that multiple threads can fill their ranges.
+         */
+        void memoryCopy(const carbon::BufferArenaAllocation& allocation, const void* data, VkDeviceSize dataSize,
+                        VkDeviceSize offset = 0) const;
+    };
+} // namespace carbon
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <carbon/vulkan.hpp>
+
+namespace carbon {
+    class Buffer;
+    class CommandBuffer;
+    class Device;
+    class Image;
+
+    // The Defragmenter incrementally compacts device memory using VMA's defragmentation API.
+    // Only registered buffers and images are moved. Each pass is limited by a byte and an
+    // allocation count budget, so that it can be spread over multiple frames:
+    //
+    //  1. beginPass records copies of the moved resources into new handles.
+    //  2. Once that command buffer has finished executing, endPass destroys the old handles,
+    //     refreshes the device addresses, mapped pointers and image views, and notifies the owners.
+    //
+    // Between beginPass and endPass, the moved resources must not be written to.
+    class Defragmenter {
+        struct Registration {
+            carbon::Buffer* buffer = nullptr;
+            carbon::Image* image = nullptr;
+            std::function<void()> onMoved;
+        };
+
+        struct PendingMove {
+            Registration registration;
+            VkBuffer newBuffer = nullptr;
+            VkImage newImage = nullptr;
+        };
+
+        carbon::Device* device = nullptr;
+        VmaAllocator allocator = nullptr;
+
+        mutable std::mutex defragMutex;
+        std::vector<Registration> registrations = {};
+
+        VmaDefragmentationContext context = nullptr;
+        VmaDefragmentationPassMoveInfo passInfo = {};
+        std::vector<PendingMove> pendingMoves = {};
+
+        auto findRegistration(VmaAllocation allocation) const -> const Registration*;
+        [[nodiscard]] static bool canMove(const Registration& registration);
+        void recordBufferMove(carbon::CommandBuffer* cmdBuffer, PendingMove& move, VmaAllocation dstAllocation);
+        void recordImageMove(carbon::CommandBuffer* cmdBuffer, PendingMove& move, VmaAllocation dstAllocation);
+        void finishBufferMove(const PendingMove& move);
+        /** Has to be called after vmaEndDefragmentationPass, which moves the allocation onto its new memory. */
+        void refreshBufferMemory(carbon::Buffer* buffer);
+        void finishImageMove(const PendingMove& move);
+
+    public:
+        explicit Defragmenter(carbon::Device* device, VmaAllocator allocator);
+
+        /**
+         * Registers a buffer that may be moved. onMoved is called after its handle and address changed.
+         * Only buffers created with the transfer source and destination usages are moved.
+         */
+        void registerBuffer(carbon::Buffer* buffer, std::function<void()> onMoved = {});
+        /**
+         * Registers an image that may be moved. onMoved is called after its handle and view changed.
+         * Only images created with the transfer source and destination usages are moved.
+         */
+        void registerImage(carbon::Image* image, std::function<void()> onMoved = {});
+        void unregister(const carbon::Buffer* buffer);
+        void unregister(const carbon::Image* image);
+
+        /** Starts a new defragmentation, optionally limited to a custom pool. */
+        void begin(VkDeviceSize maxBytesPerPass, uint32_t maxAllocationsPerPass, VmaPool pool = nullptr);
+        /** Ends the defragmentation, which may also be done before all passes have completed. */
+        void end(VmaDefragmentationStats* stats = nullptr);
+        [[nodiscard]] bool isActive() const;
+
+        /**
+         * Records the copies for the next pass into the command buffer. Returns false if there
+         * was nothing left to move, in which case the defragmentation can be ended.
+         */
+        bool beginPass(carbon::CommandBuffer* cmdBuffer);
+        /**
+         * Completes the current pass. The command buffer given to beginPass has to have
+         * finished executing. Returns false once no further passes are necessary.
+         */
+        bool endPass();
+    };
+} // namespace carbon
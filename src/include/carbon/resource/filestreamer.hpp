@@ -0,0 +1,118 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <carbon/vulkan.hpp>
+
+namespace carbon {
+    class Buffer;
+    class CommandBuffer;
+    class CommandPool;
+    class Device;
+    class Fence;
+    class Image;
+    class MappedBuffer;
+    class Queue;
+
+    // A read-only memory mapping of an entire file.
+    class MappedFile {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+
+#ifdef _WIN32
+        void* fileHandle = nullptr;
+        void* mappingHandle = nullptr;
+#else
+        int fileDescriptor = -1;
+#endif
+
+    public:
+        explicit MappedFile() = default;
+        MappedFile(const MappedFile& file) = delete;
+        ~MappedFile();
+
+        void open(const std::filesystem::path& path);
+        void close();
+
+        /** Hints the OS to start reading the given range from disk in the background. */
+        void willNeed(size_t offset, size_t rangeSize) const;
+
+        [[nodiscard]] auto getData() const -> const uint8_t*;
+        [[nodiscard]] auto getSize() const -> size_t;
+    };
+
+    struct StreamStatistics {
+        uint64_t bytesStreamed = 0;
+        uint64_t chunksSubmitted = 0;
+        /** How often a staging block was still in use by the GPU and we had to wait. */
+        uint64_t stalls = 0;
+        /** Time spent copying from the file mapping, which includes the page faults for disk reads. */
+        double copySeconds = 0.0;
+        /** Time spent waiting for staging blocks to become available. */
+        double waitSeconds = 0.0;
+
+        /** Gets the average throughput in bytes per second. */
+        [[nodiscard]] auto getThroughput() const -> double;
+    };
+
+    // The FileStreamer copies ranges of memory mapped files directly into persistently mapped
+    // staging blocks and from there into device resources. The data therefore only gets copied
+    // once on the CPU. While the GPU copies one block, the next block is already filled, and the
+    // OS is asked to read ahead the chunk after that.
+    class FileStreamer {
+        struct StagingSlot {
+            std::unique_ptr<carbon::MappedBuffer> buffer;
+            std::unique_ptr<carbon::Fence> fence;
+            std::shared_ptr<carbon::CommandBuffer> cmdBuffer;
+            bool inFlight = false;
+        };
+
+        std::shared_ptr<carbon::Device> device;
+        VmaAllocator allocator = nullptr;
+        const std::string name;
+
+        std::shared_ptr<carbon::Queue> queue;
+        std::unique_ptr<carbon::CommandPool> commandPool;
+        VkDeviceSize chunkSize = 0;
+
+        std::mutex streamMutex;
+        std::vector<StagingSlot> slots = {};
+        size_t nextSlot = 0;
+        carbon::StreamStatistics statistics = {};
+
+        /** Waits until the next slot is free and fills it with the given file range. */
+        auto fillNextSlot(const carbon::MappedFile& file, size_t fileOffset, VkDeviceSize copySize) -> StagingSlot&;
+        void submitSlot(StagingSlot& slot);
+
+    public:
+        static constexpr VkDeviceSize defaultChunkSize = 16ULL * 1024 * 1024;
+        static constexpr uint32_t defaultSlotCount = 3;
+
+        explicit FileStreamer(std::shared_ptr<carbon::Device> device, VmaAllocator allocator, std::string name = "fileStreamer");
+        ~FileStreamer();
+
+        void create(std::shared_ptr<carbon::Queue> queue, uint32_t queueFamilyIndex, VkDeviceSize chunkSize = defaultChunkSize,
+                    uint32_t slotCount = defaultSlotCount);
+        void destroy();
+
+        /** Streams size bytes starting at fileOffset into destination at dstOffset. */
+        void streamToBuffer(const carbon::MappedFile& file, size_t fileOffset, VkDeviceSize size, const carbon::Buffer* destination,
+                            VkDeviceSize dstOffset = 0);
+        /**
+         * Streams a tightly packed image region. The region is copied with a single command,
+         * which is why size may not exceed the chunk size. The image has to be in imageLayout,
+         * which is either VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL or VK_IMAGE_LAYOUT_GENERAL.
+         */
+        void streamToImage(const carbon::MappedFile& file, size_t fileOffset, VkDeviceSize size, const carbon::Image* destination,
+                           VkImageLayout imageLayout, VkBufferImageCopy region);
+        /** Waits for all submitted copies to finish. */
+        void flush();
+
+        [[nodiscard]] auto getStatistics() -> carbon::StreamStatistics;
+        void resetStatistics();
+    };
+} // namespace carbon
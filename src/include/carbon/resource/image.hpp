@@ -4,21 +4,34 @@
 #include <memory>
 #include <string>
 
+#include <carbon/base/resource_usage.hpp>
 #include <carbon/vulkan.hpp>
 
 namespace carbon {
     class Buffer;
     class CommandBuffer;
+    class Defragmenter;
     class Device;
+    class Queue;
+    class RenderGraph;
 
     class Image {
         friend class Buffer;
+        friend class Defragmenter;
+        friend class RenderGraph;
 
         std::string name;
 
         VmaAllocator allocator = nullptr;
         VmaAllocation allocation = nullptr;
 
+        // Kept around so that the image can be recreated when its memory is moved.
+        VkImageCreateInfo imageInfo = {};
+        VkImageViewCreateInfo viewInfo = {};
+
+        /** Creates the image and its memory, evicting other resources if the heap is full. */
+        auto createAllocation(const VkImageCreateInfo* imageCreateInfo, const VmaAllocationCreateInfo* allocationInfo) -> VkResult;
+
     protected:
         std::shared_ptr<carbon::Device> device;
         VkExtent2D imageExtent = { 0, 0 };
@@ -40,6 +53,8 @@ namespace carbon {
         void copyImage(carbon::CommandBuffer* cmdBuffer, VkImage image, VkImageLayout imageLayout);
         /** Destroys the image view, frees all memory and destroys the image. */
         virtual void destroy();
+        /** Like destroy, but deferred until the given submission of the queue has completed. */
+        void retire(const carbon::Queue* queue, uint64_t value);
 
         [[nodiscard]] virtual auto getDescriptorImageInfo() -> VkDescriptorImageInfo;
         [[nodiscard]] auto getImageFormat() const -> VkFormat;
@@ -51,6 +66,27 @@ namespace carbon {
         void changeLayout(carbon::CommandBuffer* cmdBuffer, VkImageLayout newLayout, const VkImageSubresourceRange& subresourceRange,
                           VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage);
 
+        /**
+         * Queues a barrier between the two usages on the command buffer, which records it
+         * together with every other pending barrier before the next command.
+         */
+        void transition(carbon::CommandBuffer* cmdBuffer, carbon::ResourceUsage srcUsage, carbon::ResourceUsage dstUsage,
+                        const VkImageSubresourceRange& subresourceRange);
+
+        /**
+         * Records the release half of a queue family ownership transfer from srcQueue to
+         * dstQueue, transitioning the image to newLayout. The matching acquire has to be recorded
+         * on dstQueue with the same layout and range, and waits for the release with a
+         * semaphore. If both queues belong to the same family, the release does nothing and the
+         * acquire is a regular barrier.
+         */
+        void releaseOwnership(carbon::CommandBuffer* cmdBuffer, const carbon::Queue* srcQueue, const carbon::Queue* dstQueue,
+                              VkImageLayout newLayout, const VkImageSubresourceRange& subresourceRange, VkPipelineStageFlags srcStage,
+                              VkAccessFlags srcAccess);
+        void acquireOwnership(carbon::CommandBuffer* cmdBuffer, const carbon::Queue* srcQueue, const carbon::Queue* dstQueue,
+                              VkImageLayout newLayout, const VkImageSubresourceRange& subresourceRange, VkPipelineStageFlags dstStage,
+                              VkAccessFlags dstAccess);
+
         static void changeLayout(VkImage image, carbon::CommandBuffer* cmdBuffer, VkImageLayout oldLayout, VkImageLayout newLayout,
                                  VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
                                  const VkImageSubresourceRange& subresourceRange);
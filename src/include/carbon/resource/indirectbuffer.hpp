@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+
+#include <carbon/resource/buffer.hpp>
+
+namespace carbon {
+    class CommandBuffer;
+
+    // An IndirectBuffer holds a draw count followed by up to maxDrawCount indexed indirect draw
+    // commands, so that all of them can be issued with a single drawIndexedIndirectCount. The
+    // draws are either built on the CPU with addDraw and upload, or written by a compute shader,
+    // like the IndirectCullPass, in which case the buffer is created device local.
+    class IndirectBuffer : public Buffer {
+        uint32_t maxDrawCount = 0;
+        bool hostWritable = false;
+        std::vector<VkDrawIndexedIndirectCommand> commands = {};
+
+    public:
+        static constexpr VkDeviceSize countOffset = 0;
+        // The count is padded to 16 bytes, so that the commands start aligned.
+        static constexpr VkDeviceSize commandOffset = 16;
+        static constexpr uint32_t commandStride = sizeof(VkDrawIndexedIndirectCommand);
+
+        explicit IndirectBuffer(carbon::Device* device, VmaAllocator allocator, std::string name = "indirectbuffer");
+
+        /**
+         * Creates the buffer for up to maxDrawCount draws. Host writable buffers are persistently
+         * mapped for upload, others are device local and can only be written by the GPU.
+         */
+        void create(uint32_t maxDrawCount, bool hostWritable = true);
+
+        /** Adds a draw to the CPU side list and returns its index. Throws if the buffer is full. */
+        auto addDraw(uint32_t indexCount, uint32_t firstIndex = 0, int32_t vertexOffset = 0, uint32_t instanceCount = 1,
+                     uint32_t firstInstance = 0) -> uint32_t;
+        void clear();
+        /** Writes the count and the draws added since the last clear into the mapped buffer. */
+        void upload() const;
+        /**
+         * Issues every draw in the buffer, using the count stored in the buffer itself. Without
+         * VK_KHR_draw_indirect_count, host writable buffers fall back to the count of draws added
+         * on the CPU, while buffers written by the GPU cannot be drawn and throw.
+         */
+        void draw(carbon::CommandBuffer* cmdBuffer) const;
+
+        /** Gets the number of draws added on the CPU. Draws written by the GPU are not counted. */
+        [[nodiscard]] auto getDrawCount() const -> uint32_t;
+        [[nodiscard]] auto getMaxDrawCount() const -> uint32_t;
+    };
+} // namespace carbon
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <carbon/vulkan.hpp>
+
+namespace carbon {
+    class Buffer;
+    class CommandBuffer;
+    class Device;
+    class Fence;
+    class Image;
+
+    /** Identifies a single readback of a ReadbackPool. */
+    struct ReadbackHandle {
+        uint64_t id = 0;
+    };
+
+    // A ReadbackPool records copies from device resources into a pool of host cached buffers,
+    // so that the results can be read on the CPU. The copies are recorded into the caller's
+    // command buffer and are tracked with the fence that command buffer is submitted with.
+    // Readbacks can then be polled every frame, so that the render thread never has to block.
+    class ReadbackPool {
+        struct Readback {
+            std::unique_ptr<carbon::Buffer> buffer;
+            VkDeviceSize size = 0;
+            carbon::Fence* fence = nullptr;
+            bool completed = false;
+        };
+
+        carbon::Device* device = nullptr;
+        VmaAllocator allocator = nullptr;
+        const std::string name;
+
+        mutable std::mutex poolMutex;
+        std::unordered_map<uint64_t, Readback> readbacks = {};
+        std::vector<std::unique_ptr<carbon::Buffer>> freeBuffers = {};
+        uint64_t nextId = 1;
+
+        auto acquireBuffer(VkDeviceSize size) -> std::unique_ptr<carbon::Buffer>;
+        auto insert(std::unique_ptr<carbon::Buffer> buffer, VkDeviceSize size, carbon::Fence* fence) -> carbon::ReadbackHandle;
+        /** Checks the readback's fence. Requires the pool's mutex to be locked. */
+        bool checkCompleted(Readback& readback);
+
+    public:
+        // Buffer sizes are rounded up to this granularity so that they can be reused more often.
+        static constexpr VkDeviceSize bufferGranularity = 64ULL * 1024;
+
+        explicit ReadbackPool(carbon::Device* device, VmaAllocator allocator, std::string name = "readbackPool");
+        ~ReadbackPool();
+
+        /** Destroys every pooled buffer. No readback may still be in flight. */
+        void destroy();
+
+        /**
+         * Records a copy of size bytes of the source buffer into a readback buffer. The fence
+         * has to be the one cmdBuffer is going to be submitted with.
+         */
+        auto readback(carbon::CommandBuffer* cmdBuffer, carbon::Fence* fence, const carbon::Buffer* source, VkDeviceSize size,
+                      VkDeviceSize srcOffset = 0) -> carbon::ReadbackHandle;
+        /**
+         * Records a copy of the given image region into a readback buffer. The image has to be
+         * in imageLayout, which is either VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL or
+         * VK_IMAGE_LAYOUT_GENERAL. The bufferOffset of the region is filled in by the pool.
+         */
+        auto readback(carbon::CommandBuffer* cmdBuffer, carbon::Fence* fence, const carbon::Image* source, VkImageLayout imageLayout,
+                      VkBufferImageCopy region, VkDeviceSize size) -> carbon::ReadbackHandle;
+
+        /** Checks whether the copy has finished without blocking. */
+        [[nodiscard]] bool isReady(carbon::ReadbackHandle handle);
+        /** Blocks until the copy has finished. Throws if the fence times out, in which case the readback stays pending. */
+        void wait(carbon::ReadbackHandle handle);
+        /** Gets the read back data. Only valid once the readback is ready and until it is released. */
+        [[nodiscard]] auto getData(carbon::ReadbackHandle handle) const -> const void*;
+        [[nodiscard]] auto getSize(carbon::ReadbackHandle handle) const -> VkDeviceSize;
+        /** Returns the readback's buffer to the pool. */
+        void release(carbon::ReadbackHandle handle);
+    };
+} // namespace carbon
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <deque>
+
+#include <carbon/resource/mappedbuffer.hpp>
+
+namespace carbon {
+    class Fence;
+
+    /** A sub-range of a RingBuffer, valid for the frame it was allocated in. */
+    struct RingBufferAllocation {
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        VkDeviceAddress deviceAddress = 0;
+        void* hostAddress = nullptr;
+    };
+
+    // A RingBuffer is a persistently mapped buffer which hands out small per-frame allocations,
+    // like uniforms or instance data, with a simple pointer bump. Every frame tags the region
+    // it allocated from with the fence of its submission, and that region is reused once the
+    // fence has signaled. This is not thread safe, use one ring per recording thread instead.
+    class RingBuffer : public MappedBuffer {
+        struct FrameMarker {
+            carbon::Fence* fence = nullptr;
+            uint64_t end = 0;
+        };
+
+        std::deque<FrameMarker> frames = {};
+
+        // head and tail are monotonically increasing byte counters. The physical offset
+        // is the counter modulo the buffer size, so that a full and an empty ring can
+        // always be told apart.
+        uint64_t head = 0;
+        uint64_t tail = 0;
+
+        // Releases the regions of all frames whose fence has signaled. The current frame
+        // is never released, as its fence might not have been submitted yet.
+        void reclaim();
+
+    public:
+        explicit RingBuffer(carbon::Device* device, VmaAllocator allocator, std::string name = "ringbuffer");
+
+        void create(uint64_t bufferSize, VkBufferUsageFlags bufferUsage = 0);
+        void destroy() override;
+
+        /**
+         * Starts a new frame whose allocations are released once the given fence signals.
+         * Passing a fence which an older frame still references marks that frame as complete,
+         * as a fence can only be reused after it has been waited on.
+         */
+        void beginFrame(carbon::Fence* fence);
+
+        /**
+         * Allocates a new aligned range for the current frame. If the ring is full, this
+         * waits on the oldest frame and throws if the current frame alone exhausts the ring.
+         */
+        [[nodiscard]] auto allocate(VkDeviceSize allocationSize, VkDeviceSize alignment = 16) -> carbon::RingBufferAllocation;
+        /** Allocates a new range and copies dataSize bytes from data into it. */
+        auto push(const void* data, VkDeviceSize dataSize, VkDeviceSize alignment = 16) -> carbon::RingBufferAllocation;
+
+        [[nodiscard]] auto getUsedSize() const -> VkDeviceSize;
+    };
+} // namespace carbon
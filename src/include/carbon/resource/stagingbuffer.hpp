@@ -7,15 +7,28 @@ namespace carbon {
     // is copied into VRAM using a command buffer. Instead of
     // having to write all of that manually each time, we abstract
     // the copies and management in a single staging buffer.
-    // TODO: Check if device is using ReBAR and skip the staging buffer if so.
+    // If the device exposes a large device local and host visible heap, like with ReBAR
+    // or on UMA devices, the staging buffer writes directly into device memory instead.
     class StagingBuffer : public Buffer {
         constexpr static const VmaMemoryUsage memoryUsage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
         constexpr static const VmaAllocationCreateFlags srcAllocationFlags = 0;
         constexpr static const VkBufferUsageFlags srcBufferUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
         constexpr static const VkBufferUsageFlags dstBufferUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
         constexpr static const VkMemoryPropertyFlags srcMemoryProperties = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        constexpr static const VkMemoryPropertyFlags directMemoryProperties =
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+        // The classic BAR is only 256MB in size and is too small to place arbitrary
+        // buffers in. Only heaps bigger than this are used for direct writes.
+        constexpr static const VkDeviceSize minDirectHeapSize = 256ULL * 1024 * 1024;
+        // Leave some room in the heap's budget for other allocations.
+        constexpr static const double maxDirectBudgetUsage = 0.9;
 
         std::unique_ptr<carbon::Buffer> gpuBuffer;
+        bool directlyMapped = false;
+
+        /** Checks if there is a large device local and host visible heap with enough budget left. */
+        [[nodiscard]] bool hasDirectMemoryBudget(VkDeviceSize bufferSize) const;
 
     public:
         explicit StagingBuffer(carbon::Device* device, VmaAllocator allocator, const std::string& name = "stagingBuffer");
@@ -29,12 +42,20 @@ namespace carbon {
          * whether reads and writes are sequential or random. In most cases, we use staging
          * buffers to sequentially write into a big block of memory, which is why most of the time
          * VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT should be used.
+         *
+         * If destinationUsage is already known, the buffer may be placed directly in device
+         * local and host visible memory, which makes createDestinationBuffer and copyIntoVram
+         * no-ops. This falls back to a regular staging buffer when that heap's budget runs out.
          */
-        void create(VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage = 0, VmaAllocationCreateFlags allocationFlags = 0);
+        void create(VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage = 0, VmaAllocationCreateFlags allocationFlags = 0,
+                    VkBufferUsageFlags destinationUsage = 0);
         void createDestinationBuffer(VkBufferUsageFlags usage);
         void destroy() override;
+        void retire(const carbon::Queue* queue, uint64_t value) override;
         void copyIntoVram(carbon::CommandBuffer* cmdBuffer);
         auto getDestinationHandle() const -> VkBuffer;
+        /** Whether this buffer lives in device memory and requires no copy. */
+        [[nodiscard]] bool isDirectlyMapped() const;
         [[nodiscard]] auto getDescriptorInfo(uint64_t rangeSize, uint64_t offset) const -> VkDescriptorBufferInfo override;
 
         // We override this function as the device address of a local buffer
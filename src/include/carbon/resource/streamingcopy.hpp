@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+namespace carbon {
+    /**
+     * Copies size bytes using non-temporal stores, which bypass the CPU caches. This is a lot
+     * faster than memcpy when writing to uncached, write-combined memory, like most host
+     * visible device memory, but slower for regular cached memory. The fastest variant
+     * supported by the CPU is selected at runtime, falling back to memcpy on other platforms.
+     */
+    void streamingCopy(void* destination, const void* source, size_t size);
+} // namespace carbon
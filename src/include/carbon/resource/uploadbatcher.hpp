@@ -0,0 +1,104 @@
+#pragma once
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <carbon/vulkan.hpp>
+
+namespace carbon {
+    class Buffer;
+    class CommandBuffer;
+    class CommandPool;
+    class Device;
+    class Image;
+    class MappedBuffer;
+    class Queue;
+
+    /**
+     * Identifies a single submitted batch of uploads. The timeline value can be passed as a
+     * carbon::TimelineWait on the batcher's queue to make other queues wait for the uploads.
+     */
+    struct UploadToken {
+        uint64_t batch = 0;
+        uint64_t timelineValue = 0;
+    };
+
+    // An UploadBatcher collects many small uploads into a few large staging blocks and copies
+    // all of them into their destinations with a single submission. Copies into the same
+    // destination are merged into a single multi-region copy command. Ideally, the batcher
+    // submits to a dedicated transfer queue. In that case, the destinations either have to be
+    // shared concurrently or have their ownership transferred to the queue using them.
+    class UploadBatcher {
+        struct StagingBlock {
+            std::unique_ptr<carbon::MappedBuffer> buffer;
+            VkDeviceSize used = 0;
+        };
+
+        struct InFlightBatch {
+            uint64_t batch = 0;
+            uint64_t timelineValue = 0;
+            std::shared_ptr<carbon::CommandBuffer> cmdBuffer;
+            std::vector<StagingBlock> blocks;
+        };
+
+        std::shared_ptr<carbon::Device> device;
+        VmaAllocator allocator = nullptr;
+        const std::string name;
+
+        std::shared_ptr<carbon::Queue> queue;
+        std::unique_ptr<carbon::CommandPool> commandPool;
+        VkDeviceSize blockSize = 0;
+
+        mutable std::mutex batchMutex;
+
+        std::vector<StagingBlock> blocks = {};
+        std::vector<StagingBlock> freeBlocks = {};
+        std::map<std::pair<VkBuffer, VkBuffer>, std::vector<VkBufferCopy>> bufferCopies = {};
+        std::map<std::tuple<VkBuffer, VkImage, VkImageLayout>, std::vector<VkBufferImageCopy>> imageCopies = {};
+        std::deque<InFlightBatch> inFlightBatches = {};
+
+        uint64_t lastSubmittedBatch = 0;
+        uint64_t lastCompletedBatch = 0;
+
+        /** Copies the data into a staging block and returns the block's handle and the offset. */
+        auto stage(const void* data, VkDeviceSize dataSize) -> std::pair<VkBuffer, VkDeviceSize>;
+        /** Recycles the oldest in-flight batch. */
+        void retireOldest();
+        /** Recycles every in-flight batch whose submission has completed on the queue's timeline. */
+        void retireCompleted();
+
+    public:
+        static constexpr VkDeviceSize defaultBlockSize = 64ULL * 1024 * 1024;
+        static constexpr VkDeviceSize stagingAlignment = 16;
+
+        explicit UploadBatcher(std::shared_ptr<carbon::Device> device, VmaAllocator allocator, std::string name = "uploadBatcher");
+        ~UploadBatcher();
+
+        void create(std::shared_ptr<carbon::Queue> queue, uint32_t queueFamilyIndex, VkDeviceSize stagingBlockSize = defaultBlockSize);
+        /** Waits for all in-flight batches and frees all staging memory. */
+        void destroy();
+
+        /** Queues a copy of dataSize bytes into destination at dstOffset. */
+        void upload(const carbon::Buffer* destination, const void* data, VkDeviceSize dataSize, VkDeviceSize dstOffset = 0);
+        /**
+         * Queues a copy into the given image region. The bufferOffset of the region is filled in
+         * by the batcher. The image has to be in imageLayout when the batch executes, which is
+         * either VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL or VK_IMAGE_LAYOUT_GENERAL.
+         */
+        void upload(const carbon::Image* destination, VkImageLayout imageLayout, const void* data, VkDeviceSize dataSize,
+                    VkBufferImageCopy region);
+
+        /**
+         * Records every queued copy into a single command buffer and submits it. Returns
+         * a token which can be used to check whether the uploads have completed.
+         */
+        auto submit() -> carbon::UploadToken;
+        [[nodiscard]] bool isComplete(carbon::UploadToken token);
+        void wait(carbon::UploadToken token);
+    };
+} // namespace carbon
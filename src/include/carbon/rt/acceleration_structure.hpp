@@ -13,6 +13,7 @@
 
 namespace carbon {
     class CommandBuffer;
+    class Queue;
 
     enum class AccelerationStructureType : uint64_t {
         BottomLevel = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
@@ -45,6 +46,8 @@ namespace carbon {
         void createStructure(VkAccelerationStructureBuildSizesInfoKHR buildSizes);
         void destroyStructure();
         virtual void destroy();
+        /** Like destroy, but deferred until the given submission of the queue has completed. */
+        virtual void retire(const carbon::Queue* queue, uint64_t value);
         auto getBuildSizes(const uint32_t* primitiveCount, VkAccelerationStructureBuildGeometryInfoKHR* buildGeometryInfo,
                            VkPhysicalDeviceAccelerationStructurePropertiesKHR asProperties) -> VkAccelerationStructureBuildSizesInfoKHR;
         auto getDescriptorWrite() const -> VkWriteDescriptorSetAccelerationStructureKHR;
@@ -70,6 +73,7 @@ namespace carbon {
         void copyMeshBuffers(carbon::CommandBuffer* cmdBuffer);
         void destroyMeshBuffers();
         void destroy() override;
+        void retire(const carbon::Queue* queue, uint64_t value) override;
     };
 
     struct TopLevelAccelerationStructure final : public AccelerationStructure {
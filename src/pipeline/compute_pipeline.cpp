@@ -0,0 +1,45 @@
+#include <algorithm>
+#include <cassert>
+
+#include <carbon/base/device.hpp>
+#include <carbon/pipeline/compute_pipeline.hpp>
+#include <carbon/pipeline/descriptor_set.hpp>
+#include <carbon/shaders/shader.hpp>
+#include <carbon/utils.hpp>
+
+carbon::ComputePipeline::ComputePipeline(carbon::Device* device) : carbon::Pipeline(device) {}
+
+void carbon::ComputePipeline::create() {
+    assert(shaderStage.module != nullptr);
+
+    std::vector<VkDescriptorSetLayout> setLayouts(descriptorSets.size());
+    std::transform(descriptorSets.begin(), descriptorSets.end(), setLayouts.begin(),
+                   [](std::shared_ptr<carbon::DescriptorSet> descriptorLayout) { return VkDescriptorSetLayout(*descriptorLayout); });
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = static_cast<uint32_t>(setLayouts.size()),
+        .pSetLayouts = setLayouts.data(),
+        .pushConstantRangeCount = static_cast<uint32_t>(ranges.size()),
+        .pPushConstantRanges = ranges.data(),
+    };
+    auto res = vkCreatePipelineLayout(*device, &pipelineLayoutCreateInfo, nullptr, &layout);
+    checkResult(res, "Failed to create compute pipeline layout");
+
+    VkComputePipelineCreateInfo computeCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = shaderStage,
+        .layout = layout,
+    };
+    res = vkCreateComputePipelines(*device, nullptr, 1, &computeCreateInfo, nullptr, &handle);
+    checkResult(res, "Failed to create compute pipeline");
+}
+
+VkPipelineBindPoint carbon::ComputePipeline::getBindPoint() const noexcept { return VK_PIPELINE_BIND_POINT_COMPUTE; }
+
+void carbon::ComputePipeline::setName(const std::string& name) noexcept { device->setDebugUtilsName(handle, name); }
+
+void carbon::ComputePipeline::setShaderModule(carbon::ShaderModule* shader) {
+    assert(shader->getShaderStage() == carbon::ShaderStage::Compute);
+    shaderStage = shader->getShaderStageCreateInfo();
+}
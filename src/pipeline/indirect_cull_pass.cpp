@@ -0,0 +1,109 @@
+#include <stdexcept>
+#include <utility>
+
+#include <carbon/base/command_buffer.hpp>
+#include <carbon/base/device.hpp>
+#include <carbon/pipeline/compute_pipeline.hpp>
+#include <carbon/pipeline/indirect_cull_pass.hpp>
+#include <carbon/resource/indirectbuffer.hpp>
+#include <carbon/shaders/shader.hpp>
+
+const char* const carbon::IndirectCullPass::shaderSource = R"(#version 460
+#extension GL_EXT_buffer_reference : require
+
+layout(local_size_x = 64) in;
+
+struct Instance {
+    vec4 boundingSphere;
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint instanceIndex;
+};
+
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer InstanceBuffer {
+    Instance instances[];
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) buffer DrawBuffer {
+    uint drawCount;
+    uint padding[3];
+    DrawCommand draws[];
+};
+
+layout(push_constant) uniform Constants {
+    InstanceBuffer instanceBuffer;
+    DrawBuffer drawBuffer;
+    vec4 frustumPlanes[6];
+    uint instanceCount;
+    uint maxDrawCount;
+};
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= instanceCount)
+        return;
+
+    Instance instance = instanceBuffer.instances[index];
+    for (int i = 0; i < 6; ++i) {
+        if (dot(frustumPlanes[i].xyz, instance.boundingSphere.xyz) + frustumPlanes[i].w < -instance.boundingSphere.w)
+            return;
+    }
+
+    // The count may grow past maxDrawCount, which drawIndexedIndirectCount clamps again.
+    uint slot = atomicAdd(drawBuffer.drawCount, 1);
+    if (slot < maxDrawCount)
+        drawBuffer.draws[slot] = DrawCommand(instance.indexCount, 1, instance.firstIndex, instance.vertexOffset, instance.instanceIndex);
+}
+)";
+
+carbon::IndirectCullPass::IndirectCullPass(std::shared_ptr<carbon::Device> device) : device(std::move(device)) {}
+
+carbon::IndirectCullPass::~IndirectCullPass() = default;
+
+void carbon::IndirectCullPass::create(carbon::ShaderModule* shader) {
+    // The culled draw count only exists on the GPU, so it has to be read by the draw itself.
+    if (!device->supportsDrawIndirectCount())
+        throw std::runtime_error("GPU culling requires VK_KHR_draw_indirect_count, which is not supported");
+
+    pipeline = std::make_unique<carbon::ComputePipeline>(device.get());
+    pipeline->setShaderModule(shader);
+    pipeline->addPushConstant(sizeof(PushConstants), carbon::ShaderStage::Compute);
+    pipeline->create();
+    pipeline->setName("indirectCullPass");
+}
+
+void carbon::IndirectCullPass::destroy() {
+    if (pipeline != nullptr)
+        pipeline->destroy();
+    pipeline.reset();
+}
+
+void carbon::IndirectCullPass::record(carbon::CommandBuffer* cmdBuffer, const carbon::Buffer* instances, uint32_t instanceCount,
+                                      const carbon::IndirectBuffer* output, const carbon::FrustumPlanes& frustumPlanes) const {
+    // The draws of the previous use of the output have to be done before the count is reset.
+    cmdBuffer->bufferBarrier(output, carbon::ResourceUsage::IndirectBuffer, carbon::ResourceUsage::TransferDst);
+    cmdBuffer->fillBuffer(output, carbon::IndirectBuffer::countOffset, sizeof(uint32_t), 0);
+    cmdBuffer->bufferBarrier(output, carbon::ResourceUsage::TransferDst, carbon::ResourceUsage::StorageReadWrite);
+
+    PushConstants constants = {
+        .instances = instances->getDeviceAddress(),
+        .output = output->getDeviceAddress(),
+        .frustumPlanes = frustumPlanes,
+        .instanceCount = instanceCount,
+        .maxDrawCount = output->getMaxDrawCount(),
+    };
+    cmdBuffer->bindPipeline(pipeline.get());
+    cmdBuffer->pushConstants(pipeline.get(), carbon::ShaderStage::Compute, sizeof(PushConstants), &constants);
+    cmdBuffer->dispatch((instanceCount + workgroupSize - 1) / workgroupSize);
+
+    cmdBuffer->bufferBarrier(output, carbon::ResourceUsage::StorageReadWrite, carbon::ResourceUsage::IndirectBuffer);
+}
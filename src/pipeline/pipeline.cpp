@@ -21,4 +21,15 @@ void carbon::Pipeline::destroy() {
         vkDestroyPipelineLayout(*device, layout, nullptr);
 }
 
+void carbon::Pipeline::retire(const carbon::Queue* queue, uint64_t value) {
+    device->retire(queue, value, [device = device, handle = handle, layout = layout]() {
+        if (handle != nullptr)
+            vkDestroyPipeline(*device, handle, nullptr);
+        if (layout != nullptr)
+            vkDestroyPipelineLayout(*device, layout, nullptr);
+    });
+    handle = nullptr;
+    layout = nullptr;
+}
+
 carbon::Pipeline::operator VkPipeline() const { return handle; }
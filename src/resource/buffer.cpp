@@ -1,17 +1,27 @@
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
 #include <carbon/base/command_buffer.hpp>
 #include <carbon/base/device.hpp>
+#include <carbon/base/memory_budget.hpp>
+#include <carbon/base/queue.hpp>
+#include <carbon/base/thread_pool.hpp>
 #include <carbon/resource/buffer.hpp>
 #include <carbon/resource/image.hpp>
+#include <carbon/resource/streamingcopy.hpp>
 #include <carbon/utils.hpp>
 
 carbon::Buffer::Buffer(carbon::Device* device, VmaAllocator allocator) : device(device), allocator(allocator) {}
 
 carbon::Buffer::Buffer(carbon::Device* device, VmaAllocator allocator, std::string name)
-    : device(device), name(std::move(name)), allocator(allocator) {}
+    : name(std::move(name)), device(device), allocator(allocator) {}
 
 carbon::Buffer::Buffer(const carbon::Buffer& buffer)
-    : device(buffer.device), name(buffer.name), allocator(buffer.allocator), allocation(buffer.allocation), address(buffer.address),
-      handle(buffer.handle) {}
+    : name(buffer.name), allocation(buffer.allocation), bufferUsage(buffer.bufferUsage), memoryUsage(buffer.memoryUsage),
+      memoryProperties(buffer.memoryProperties), allocationFlags(buffer.allocationFlags), writeCombined(buffer.writeCombined),
+      device(buffer.device), allocator(buffer.allocator), size(buffer.size), address(buffer.address), handle(buffer.handle),
+      mappedData(buffer.mappedData) {}
 
 carbon::Buffer& carbon::Buffer::operator=(const carbon::Buffer& buffer) {
     if (&buffer == this)
@@ -20,12 +30,24 @@ carbon::Buffer& carbon::Buffer::operator=(const carbon::Buffer& buffer) {
     this->handle = buffer.handle;
     this->address = buffer.address;
     this->allocation = buffer.allocation;
-    this->handle = buffer.handle;
+    this->mappedData = buffer.mappedData;
+    this->size = buffer.size;
+    this->bufferUsage = buffer.bufferUsage;
+    this->memoryUsage = buffer.memoryUsage;
+    this->memoryProperties = buffer.memoryProperties;
+    this->allocationFlags = buffer.allocationFlags;
+    this->writeCombined = buffer.writeCombined;
     this->name = buffer.name;
     return *this;
 }
 
 void carbon::Buffer::create(const VkDeviceSize newSize, const VkBufferUsageFlags newBufferUsage, const VmaAllocationCreateFlags newAllocationFlags, const VkMemoryPropertyFlags newProperties) {
+    auto result = tryCreate(newSize, newBufferUsage, newAllocationFlags, newProperties);
+    checkResult(result, "Failed to create buffer \"" + name + "\"");
+}
+
+auto carbon::Buffer::tryCreate(const VkDeviceSize newSize, const VkBufferUsageFlags newBufferUsage,
+                               const VmaAllocationCreateFlags newAllocationFlags, const VkMemoryPropertyFlags newProperties) -> VkResult {
     this->size = newSize;
     this->bufferUsage = newBufferUsage;
     this->allocationFlags = newAllocationFlags;
@@ -49,10 +71,37 @@ void carbon::Buffer::create(const VkDeviceSize newSize, const VkBufferUsageFlags
         .requiredFlags = memoryProperties,
     };
 
-    auto result = vmaCreateBuffer(allocator, &bufferCreateInfo, &allocationInfo, &handle, &allocation, nullptr);
-    checkResult(result, "Failed to create buffer \"" + name + "\"");
+    // Make some room by evicting other resources before the allocation would exceed the
+    // budget. Once the driver itself runs out of memory, it is too late for that.
+    auto* budget = device->getMemoryBudget();
+    if (budget != nullptr) {
+        auto heapIndex = budget->getHeapIndex(memoryProperties != 0 ? memoryProperties : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (heapIndex != VK_MAX_MEMORY_HEAPS)
+            budget->ensureAvailable(heapIndex, size);
+    }
+
+    VmaAllocationInfo allocationResultInfo = {};
+    auto result = vmaCreateBuffer(allocator, &bufferCreateInfo, &allocationInfo, &handle, &allocation, &allocationResultInfo);
+    if (result != VK_SUCCESS) {
+        handle = nullptr;
+        allocation = nullptr;
+        return result;
+    }
     assert(allocation != nullptr);
 
+    if (budget != nullptr)
+        budget->trackAllocation(allocation, name);
+
+    // Persistently mapped allocations keep their pointer until they are freed, which
+    // saves us from mapping and unmapping the memory on every copy.
+    if ((allocationFlags & VMA_ALLOCATION_CREATE_MAPPED_BIT) != 0)
+        mappedData = allocationResultInfo.pMappedData;
+
+    VkMemoryPropertyFlags allocationProperties = 0;
+    vmaGetAllocationMemoryProperties(allocator, allocation, &allocationProperties);
+    writeCombined = isFlagSet(allocationProperties, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+                    !isFlagSet(allocationProperties, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+
     if (isFlagSet(bufferUsage, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)) {
         auto addressInfo = getBufferAddressInfo(handle);
         address = carbon::Buffer::getBufferDeviceAddress(device, &addressInfo);
@@ -61,13 +110,31 @@ void carbon::Buffer::create(const VkDeviceSize newSize, const VkBufferUsageFlags
     if (!name.empty()) {
         device->setDebugUtilsName(handle, name);
     }
+    return VK_SUCCESS;
 }
 
 void carbon::Buffer::destroy() {
     if (handle == nullptr || allocation == nullptr)
         return;
+    if (auto* budget = device->getMemoryBudget(); budget != nullptr)
+        budget->untrackAllocation(allocation);
     vmaDestroyBuffer(allocator, handle, allocation);
     handle = nullptr;
+    mappedData = nullptr;
+}
+
+void carbon::Buffer::retire(const carbon::Queue* queue, uint64_t value) {
+    if (handle == nullptr || allocation == nullptr)
+        return;
+    device->retire(queue, value, [device = device, allocator = allocator, handle = handle, allocation = allocation]() {
+        if (auto* budget = device->getMemoryBudget(); budget != nullptr)
+            budget->untrackAllocation(allocation);
+        vmaDestroyBuffer(allocator, handle, allocation);
+    });
+    handle = nullptr;
+    allocation = nullptr;
+    mappedData = nullptr;
+    address = 0;
 }
 
 void carbon::Buffer::lock() const { memoryMutex.lock(); }
@@ -75,10 +142,52 @@ void carbon::Buffer::lock() const { memoryMutex.lock(); }
 void carbon::Buffer::resize(VkDeviceSize newSize) {
     if (newSize > size) {
         destroy();
-        create(newSize, bufferUsage, memoryUsage, memoryProperties);
+        create(newSize, bufferUsage, allocationFlags, memoryProperties);
     }
 }
 
+auto carbon::Buffer::grow(carbon::CommandBuffer* cmdBuffer, VkDeviceSize requiredSize) -> std::unique_ptr<carbon::Buffer> {
+    if (requiredSize <= size)
+        return nullptr;
+    assert(isFlagSet(bufferUsage, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT));
+
+    // The new allocation with at least double the capacity is created into a separate buffer
+    // first, so that this buffer stays untouched if that fails. The allocations are then
+    // swapped, which leaves the old one in a plain Buffer, regardless of the type of this one.
+    auto oldBuffer = std::make_unique<carbon::Buffer>(device, allocator, name);
+    oldBuffer->memoryUsage = memoryUsage;
+    oldBuffer->create(std::max(size * 2, requiredSize), bufferUsage, allocationFlags, memoryProperties);
+    std::swap(handle, oldBuffer->handle);
+    std::swap(allocation, oldBuffer->allocation);
+    std::swap(mappedData, oldBuffer->mappedData);
+    std::swap(address, oldBuffer->address);
+    std::swap(size, oldBuffer->size);
+    std::swap(writeCombined, oldBuffer->writeCombined);
+
+    if (oldBuffer->handle != nullptr && oldBuffer->size != 0) {
+        VkMemoryBarrier memoryBarrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        };
+        cmdBuffer->pipelineBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0,
+                                   nullptr);
+
+        VkBufferCopy copy = {
+            .srcOffset = 0,
+            .dstOffset = 0,
+            .size = oldBuffer->size,
+        };
+        cmdBuffer->copyBuffer(oldBuffer->handle, handle, { copy });
+
+        auto bufferBarrier = getMemoryBarrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT);
+        bufferBarrier.size = oldBuffer->size;
+        cmdBuffer->pipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0,
+                                   nullptr);
+    }
+    return oldBuffer;
+}
+
 void carbon::Buffer::unlock() const { memoryMutex.unlock(); }
 
 auto carbon::Buffer::getCreateInfo() const -> VkBufferCreateInfo {
@@ -112,6 +221,8 @@ auto carbon::Buffer::getDescriptorInfo(const VkDeviceSize bufferRange, const VkD
 
 auto carbon::Buffer::getHandle() const -> VkBuffer { return this->handle; }
 
+auto carbon::Buffer::getMappedData() const -> void* { return this->mappedData; }
+
 auto carbon::Buffer::getDeviceOrHostConstAddress() const -> const VkDeviceOrHostAddressConstKHR {
     return {
         .deviceAddress = address,
@@ -133,13 +244,132 @@ auto carbon::Buffer::getMemoryBarrier(VkAccessFlags srcAccess, VkAccessFlags dst
 
 auto carbon::Buffer::getSize() const -> VkDeviceSize { return size; }
 
+void carbon::Buffer::releaseOwnership(carbon::CommandBuffer* cmdBuffer, const carbon::Queue* srcQueue, const carbon::Queue* dstQueue,
+                                      VkPipelineStageFlags srcStage, VkAccessFlags srcAccess) const {
+    if (srcQueue->getFamilyIndex() == dstQueue->getFamilyIndex())
+        return;
+
+    // The destination access is ignored for a release, the acquire makes the writes visible.
+    auto bufferBarrier = getMemoryBarrier(srcAccess, 0);
+    bufferBarrier.srcQueueFamilyIndex = srcQueue->getFamilyIndex();
+    bufferBarrier.dstQueueFamilyIndex = dstQueue->getFamilyIndex();
+    cmdBuffer->pipelineBarrier(srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+}
+
+void carbon::Buffer::acquireOwnership(carbon::CommandBuffer* cmdBuffer, const carbon::Queue* srcQueue, const carbon::Queue* dstQueue,
+                                      VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) const {
+    if (srcQueue->getFamilyIndex() == dstQueue->getFamilyIndex()) {
+        // There was no release, so this has to be a regular barrier.
+        auto bufferBarrier = getMemoryBarrier(VK_ACCESS_MEMORY_WRITE_BIT, dstAccess);
+        cmdBuffer->pipelineBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, dstStage, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+        return;
+    }
+
+    auto bufferBarrier = getMemoryBarrier(0, dstAccess);
+    bufferBarrier.srcQueueFamilyIndex = srcQueue->getFamilyIndex();
+    bufferBarrier.dstQueueFamilyIndex = dstQueue->getFamilyIndex();
+    cmdBuffer->pipelineBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+}
+
+void carbon::Buffer::copyToMapped(void* destination, const void* source, uint64_t copySize) const {
+    if (writeCombined) {
+        carbon::streamingCopy(destination, source, copySize);
+    } else {
+        memcpy(destination, source, copySize);
+    }
+}
+
 void carbon::Buffer::memoryCopy(const void* source, uint64_t copySize, uint64_t offset) const {
+    if (mappedData != nullptr) {
+        copyToMapped(reinterpret_cast<uint8_t*>(mappedData) + offset, source, copySize);
+        return;
+    }
+
     void* dst;
     this->mapMemory(&dst);
-    memcpy(reinterpret_cast<uint8_t*>(dst) + offset, source, copySize); // uint8_t as we want bytes.
+    copyToMapped(reinterpret_cast<uint8_t*>(dst) + offset, source, copySize); // uint8_t as we want bytes.
     this->unmapMemory();
 }
 
+void carbon::Buffer::writeRange(const void* source, uint64_t copySize, uint64_t offset) const {
+    assert(offset + copySize <= size);
+    if (mappedData != nullptr) {
+        copyToMapped(reinterpret_cast<uint8_t*>(mappedData) + offset, source, copySize);
+        return;
+    }
+
+    // VMA reference counts mappings, but does not synchronize the map count of dedicated
+    // allocations. Mapping and unmapping therefore go through memoryMutex, while the copy
+    // itself runs unlocked, so that writers to different ranges still run in parallel.
+    void* dst;
+    {
+        std::scoped_lock lock(memoryMutex);
+        auto result = vmaMapMemory(allocator, allocation, &dst);
+        checkResult(result, "Failed to map memory");
+    }
+    copyToMapped(reinterpret_cast<uint8_t*>(dst) + offset, source, copySize);
+    {
+        std::scoped_lock lock(memoryMutex);
+        vmaUnmapMemory(allocator, allocation);
+    }
+}
+
+auto carbon::Buffer::memoryCopy(carbon::ThreadPool* threadPool, const void* source, uint64_t copySize, uint64_t offset) const
+    -> std::future<void> {
+    assert(offset + copySize <= size);
+    std::promise<void> promise;
+    auto future = promise.get_future();
+    if (threadPool == nullptr || copySize < parallelCopyChunkSize * 2) {
+        writeRange(source, copySize, offset);
+        promise.set_value();
+        return future;
+    }
+
+    // Persistently mapped buffers are used as is. Otherwise the chunks share a single mapping,
+    // which VMA reference counts, so that the memory stays mapped even if other threads map and
+    // unmap the buffer in the meantime. VMA does not synchronize the map count of dedicated
+    // allocations, so mapping and unmapping go through memoryMutex.
+    const bool persistentlyMapped = mappedData != nullptr;
+    auto* dst = static_cast<uint8_t*>(mappedData);
+    if (!persistentlyMapped) {
+        std::scoped_lock lock(memoryMutex);
+        auto result = vmaMapMemory(allocator, allocation, reinterpret_cast<void**>(&dst));
+        checkResult(result, "Failed to map memory");
+    }
+
+    struct ParallelCopy {
+        std::promise<void> promise;
+        std::atomic<uint64_t> remainingChunks = 0;
+    };
+    const auto chunkCount = (copySize + parallelCopyChunkSize - 1) / parallelCopyChunkSize;
+    auto state = std::make_shared<ParallelCopy>();
+    state->promise = std::move(promise);
+    state->remainingChunks = chunkCount;
+
+    for (uint64_t chunk = 0; chunk < chunkCount; ++chunk) {
+        const auto chunkOffset = chunk * parallelCopyChunkSize;
+        const auto chunkSize = std::min(parallelCopyChunkSize, copySize - chunkOffset);
+        threadPool->enqueue([this, state, dst, source, offset, chunkOffset, chunkSize, persistentlyMapped]() {
+            copyToMapped(dst + offset + chunkOffset, static_cast<const uint8_t*>(source) + chunkOffset, chunkSize);
+
+            // The last chunk to finish releases the mapping and completes the future.
+            if (state->remainingChunks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                if (!persistentlyMapped) {
+                    std::scoped_lock lock(memoryMutex);
+                    vmaUnmapMemory(allocator, allocation);
+                }
+                state->promise.set_value();
+            }
+        });
+    }
+    return future;
+}
+
+void carbon::Buffer::invalidateMemory(VkDeviceSize offset, VkDeviceSize invalidateSize) const {
+    auto result = vmaInvalidateAllocation(allocator, allocation, offset, invalidateSize);
+    checkResult(result, "Failed to invalidate memory");
+}
+
 void carbon::Buffer::mapMemory(void** destination) const {
     memoryMutex.lock();
     auto result = vmaMapMemory(allocator, allocation, destination);
@@ -159,10 +389,10 @@ void carbon::Buffer::copyToBuffer(carbon::CommandBuffer* cmdBuffer, const carbon
         .dstOffset = 0,
         .size = size,
     };
-    vkCmdCopyBuffer(VkCommandBuffer(*cmdBuffer), handle, destination->handle, 1, &copy);
+    cmdBuffer->copyBuffer(handle, destination->handle, { copy });
 }
 
 void carbon::Buffer::copyToImage(carbon::CommandBuffer* cmdBuffer, const carbon::Image* destination, VkImageLayout imageLayout,
                                  VkBufferImageCopy* copy) {
-    vkCmdCopyBufferToImage(VkCommandBuffer(*cmdBuffer), handle, destination->handle, imageLayout, 1, copy);
+    cmdBuffer->copyBufferToImage(handle, destination->handle, imageLayout, { *copy });
 }
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+#include <fmt/core.h>
+
+#include <carbon/resource/buffer.hpp>
+#include <carbon/resource/bufferarena.hpp>
+#include <carbon/utils.hpp>
+
+carbon::BufferArena::BufferArena(carbon::Device* device, VmaAllocator allocator, std::string name)
+    : device(device), allocator(allocator), name(std::move(name)) {}
+
+carbon::BufferArena::~BufferArena() = default;
+
+void carbon::BufferArena::create(VkBufferUsageFlags usage, VmaAllocationCreateFlags flags, VkMemoryPropertyFlags properties,
+                                 VkDeviceSize newBlockSize) {
+    bufferUsage = usage;
+    allocationFlags = flags;
+    memoryProperties = properties;
+    blockSize = newBlockSize;
+}
+
+void carbon::BufferArena::destroy() {
+    std::scoped_lock lock(arenaMutex);
+    for (auto& block : blocks)
+        destroyBlock(block);
+    blocks.clear();
+}
+
+auto carbon::BufferArena::createBlock(VkDeviceSize size) -> uint32_t {
+    Block block = {
+        .buffer = std::make_unique<carbon::Buffer>(device, allocator, fmt::format("{}_block{}", name, blocks.size())),
+    };
+    block.buffer->create(size, bufferUsage, allocationFlags, memoryProperties);
+
+    VmaVirtualBlockCreateInfo blockInfo = {
+        .size = size,
+    };
+    auto result = vmaCreateVirtualBlock(&blockInfo, &block.virtualBlock);
+    checkResult(result, "Failed to create virtual block");
+
+    // Reuse a slot of a previously released block, so that block indices stay stable.
+    auto freeSlot = std::find_if(blocks.begin(), blocks.end(), [](const Block& b) { return b.virtualBlock == nullptr; });
+    if (freeSlot != blocks.end()) {
+        *freeSlot = std::move(block);
+        return static_cast<uint32_t>(std::distance(blocks.begin(), freeSlot));
+    }
+    blocks.push_back(std::move(block));
+    return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+void carbon::BufferArena::destroyBlock(Block& block) {
+    if (block.virtualBlock != nullptr) {
+        vmaClearVirtualBlock(block.virtualBlock);
+        vmaDestroyVirtualBlock(block.virtualBlock);
+        block.virtualBlock = nullptr;
+    }
+    if (block.buffer != nullptr) {
+        block.buffer->destroy();
+        block.buffer.reset();
+    }
+}
+
+auto carbon::BufferArena::allocate(VkDeviceSize size, VkDeviceSize alignment) -> carbon::BufferArenaAllocation {
+    assert(size != 0);
+    assert((alignment & (alignment - 1)) == 0);
+
+    VmaVirtualAllocationCreateInfo allocationInfo = {
+        .size = size,
+        .alignment = alignment,
+    };
+
+    std::scoped_lock lock(arenaMutex);
+    VmaVirtualAllocation virtualAllocation = nullptr;
+    VkDeviceSize offset = 0;
+    uint32_t blockIndex = 0;
+    for (; blockIndex < blocks.size(); ++blockIndex) {
+        if (blocks[blockIndex].virtualBlock == nullptr)
+            continue;
+        if (vmaVirtualAllocate(blocks[blockIndex].virtualBlock, &allocationInfo, &virtualAllocation, &offset) == VK_SUCCESS)
+            break;
+    }
+
+    if (virtualAllocation == nullptr) {
+        blockIndex = createBlock(std::max(blockSize, size));
+        auto result = vmaVirtualAllocate(blocks[blockIndex].virtualBlock, &allocationInfo, &virtualAllocation, &offset);
+        checkResult(result, fmt::format("Failed to allocate {} bytes from buffer arena \"{}\"", size, name));
+    }
+
+    const auto& buffer = blocks[blockIndex].buffer;
+    auto* mappedData = static_cast<uint8_t*>(buffer->getMappedData());
+    auto baseAddress = buffer->getDeviceAddress();
+    return {
+        .buffer = buffer->getHandle(),
+        .offset = offset,
+        .size = size,
+        .deviceAddress = baseAddress != 0 ? baseAddress + offset : 0,
+        .hostAddress = mappedData != nullptr ? mappedData + offset : nullptr,
+        .blockIndex = blockIndex,
+        .virtualAllocation = virtualAllocation,
+        .blockBuffer = buffer.get(),
+    };
+}
+
+void carbon::BufferArena::free(carbon::BufferArenaAllocation& allocation) {
+    if (allocation.virtualAllocation == nullptr)
+        return;
+
+    std::scoped_lock lock(arenaMutex);
+    auto& block = blocks[allocation.blockIndex];
+    vmaVirtualFree(block.virtualBlock, allocation.virtualAllocation);
+
+    // Blocks which were created for a single large allocation are released right away.
+    if (block.buffer->getSize() > blockSize && vmaIsVirtualBlockEmpty(block.virtualBlock))
+        destroyBlock(block);
+
+    allocation = {};
+}
+
+auto carbon::BufferArena::getBuffer(const carbon::BufferArenaAllocation& allocation) const -> carbon::Buffer* {
+    return allocation.blockBuffer;
+}
+
+auto carbon::BufferArena::getBlockCount() const -> size_t {
+    std::scoped_lock lock(arenaMutex);
+    return std::count_if(blocks.begin(), blocks.end(), [](const Block& block) { return block.virtualBlock != nullptr; });
+}
+
+void carbon::BufferArena::memoryCopy(const carbon::BufferArenaAllocation& allocation, const void* data, VkDeviceSize dataSize,
+                                     VkDeviceSize offset) const {
+    assert(offset + dataSize <= allocation.size);
+    assert(allocation.blockBuffer != nullptr);
+    allocation.blockBuffer->writeRange(data, dataSize, allocation.offset + offset);
+}
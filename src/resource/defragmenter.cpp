@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <cassert>
+
+#include <carbon/base/command_buffer.hpp>
+#include <carbon/base/device.hpp>
+#include <carbon/resource/buffer.hpp>
+#include <carbon/resource/defragmenter.hpp>
+#include <carbon/resource/image.hpp>
+#include <carbon/utils.hpp>
+
+carbon::Defragmenter::Defragmenter(carbon::Device* device, VmaAllocator allocator) : device(device), allocator(allocator) {}
+
+void carbon::Defragmenter::registerBuffer(carbon::Buffer* buffer, std::function<void()> onMoved) {
+    std::scoped_lock lock(defragMutex);
+    registrations.push_back({ .buffer = buffer, .onMoved = std::move(onMoved) });
+}
+
+void carbon::Defragmenter::registerImage(carbon::Image* image, std::function<void()> onMoved) {
+    std::scoped_lock lock(defragMutex);
+    registrations.push_back({ .image = image, .onMoved = std::move(onMoved) });
+}
+
+void carbon::Defragmenter::unregister(const carbon::Buffer* buffer) {
+    std::scoped_lock lock(defragMutex);
+    std::erase_if(registrations, [buffer](const Registration& registration) { return registration.buffer == buffer; });
+}
+
+void carbon::Defragmenter::unregister(const carbon::Image* image) {
+    std::scoped_lock lock(defragMutex);
+    std::erase_if(registrations, [image](const Registration& registration) { return registration.image == image; });
+}
+
+auto carbon::Defragmenter::findRegistration(VmaAllocation allocation) const -> const Registration* {
+    // Resources might have been recreated since they were registered, which is why we
+    // compare against their current allocation instead of caching it.
+    auto registration = std::find_if(registrations.begin(), registrations.end(), [allocation](const Registration& registration) {
+        if (registration.buffer != nullptr)
+            return registration.buffer->allocation == allocation;
+        return registration.image != nullptr && registration.image->allocation == allocation;
+    });
+    return registration != registrations.end() ? &*registration : nullptr;
+}
+
+bool carbon::Defragmenter::canMove(const Registration& registration) {
+    // The new handle is created with the same usage, so both have to be set.
+    if (registration.buffer != nullptr)
+        return isFlagSet(registration.buffer->bufferUsage, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    return isFlagSet(registration.image->imageInfo.usage, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+}
+
+void carbon::Defragmenter::begin(VkDeviceSize maxBytesPerPass, uint32_t maxAllocationsPerPass, VmaPool pool) {
+    std::scoped_lock lock(defragMutex);
+    assert(context == nullptr);
+
+    VmaDefragmentationInfo defragmentationInfo = {
+        .flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT,
+        .pool = pool,
+        .maxBytesPerPass = maxBytesPerPass,
+        .maxAllocationsPerPass = maxAllocationsPerPass,
+    };
+    auto result = vmaBeginDefragmentation(allocator, &defragmentationInfo, &context);
+    checkResult(result, "Failed to begin defragmentation");
+}
+
+void carbon::Defragmenter::end(VmaDefragmentationStats* stats) {
+    std::scoped_lock lock(defragMutex);
+    if (context == nullptr)
+        return;
+
+    // A pass that has been started has to be completed before ending the defragmentation.
+    // We discard the new handles, which leaves every resource at its old location.
+    if (!pendingMoves.empty()) {
+        for (uint32_t i = 0; i < passInfo.moveCount; ++i)
+            passInfo.pMoves[i].operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+        for (auto& move : pendingMoves) {
+            if (move.newBuffer != nullptr)
+                vkDestroyBuffer(*device, move.newBuffer, nullptr);
+            if (move.newImage != nullptr)
+                vkDestroyImage(*device, move.newImage, nullptr);
+        }
+        pendingMoves.clear();
+        vmaEndDefragmentationPass(allocator, context, &passInfo);
+    }
+
+    vmaEndDefragmentation(allocator, context, stats);
+    context = nullptr;
+    passInfo = {};
+}
+
+bool carbon::Defragmenter::isActive() const {
+    std::scoped_lock lock(defragMutex);
+    return context != nullptr;
+}
+
+bool carbon::Defragmenter::beginPass(carbon::CommandBuffer* cmdBuffer) {
+    std::scoped_lock lock(defragMutex);
+    assert(context != nullptr && pendingMoves.empty());
+
+    auto result = vmaBeginDefragmentationPass(allocator, context, &passInfo);
+    if (result == VK_SUCCESS)
+        return false;
+    if (result != VK_INCOMPLETE)
+        checkResult(result, "Failed to begin defragmentation pass");
+
+    // Wait for all previous work on the moved resources before copying them.
+    VkMemoryBarrier memoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+    };
+    cmdBuffer->pipelineBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0,
+                               nullptr);
+
+    for (uint32_t i = 0; i < passInfo.moveCount; ++i) {
+        auto& vmaMove = passInfo.pMoves[i];
+        const auto* registration = findRegistration(vmaMove.srcAllocation);
+        if (registration == nullptr) {
+            // We don't know who owns this allocation, so we can't update its handles.
+            vmaMove.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+        if (!canMove(*registration)) {
+            // The copy would be invalid without the transfer usages.
+            vmaMove.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+
+        PendingMove move = {
+            .registration = *registration,
+        };
+        if (registration->buffer != nullptr) {
+            recordBufferMove(cmdBuffer, move, vmaMove.dstTmpAllocation);
+        } else {
+            recordImageMove(cmdBuffer, move, vmaMove.dstTmpAllocation);
+        }
+        pendingMoves.push_back(std::move(move));
+    }
+
+    memoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+    };
+    cmdBuffer->pipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0,
+                               nullptr);
+    return true;
+}
+
+void carbon::Defragmenter::recordBufferMove(carbon::CommandBuffer* cmdBuffer, PendingMove& move, VmaAllocation dstAllocation) {
+    auto* buffer = move.registration.buffer;
+    auto createInfo = buffer->getCreateInfo();
+    auto result = vkCreateBuffer(*device, &createInfo, nullptr, &move.newBuffer);
+    checkResult(result, "Failed to create buffer for defragmentation");
+    result = vmaBindBufferMemory(allocator, dstAllocation, move.newBuffer);
+    checkResult(result, "Failed to bind buffer memory for defragmentation");
+
+    VkBufferCopy copy = {
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = buffer->size,
+    };
+    cmdBuffer->copyBuffer(buffer->handle, move.newBuffer, { copy });
+}
+
+void carbon::Defragmenter::recordImageMove(carbon::CommandBuffer* cmdBuffer, PendingMove& move, VmaAllocation dstAllocation) {
+    auto* image = move.registration.image;
+    auto createInfo = image->imageInfo;
+    createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    auto result = vkCreateImage(*device, &createInfo, nullptr, &move.newImage);
+    checkResult(result, "Failed to create image for defragmentation");
+    result = vmaBindImageMemory(allocator, dstAllocation, move.newImage);
+    checkResult(result, "Failed to bind image memory for defragmentation");
+
+    const auto aspectMask = image->viewInfo.subresourceRange.aspectMask;
+    for (uint32_t mip = 0; mip < createInfo.mipLevels; ++mip) {
+        auto layout = image->currentLayouts.contains(mip) ? image->currentLayouts[mip] : image->currentLayouts[0];
+        VkImageSubresourceRange range = {
+            .aspectMask = aspectMask,
+            .baseMipLevel = mip,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = createInfo.arrayLayers,
+        };
+
+        // Images which have never been written to don't have any contents to preserve.
+        if (layout == VK_IMAGE_LAYOUT_UNDEFINED)
+            continue;
+
+        carbon::Image::changeLayout(image->handle, cmdBuffer, layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                    VK_PIPELINE_STAGE_TRANSFER_BIT, range);
+        carbon::Image::changeLayout(move.newImage, cmdBuffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, range);
+
+        VkImageCopy copy = {
+            .srcSubresource = { aspectMask, mip, 0, createInfo.arrayLayers },
+            .dstSubresource = { aspectMask, mip, 0, createInfo.arrayLayers },
+            .extent = {
+                .width = std::max(1U, createInfo.extent.width >> mip),
+                .height = std::max(1U, createInfo.extent.height >> mip),
+                .depth = std::max(1U, createInfo.extent.depth >> mip),
+            },
+        };
+        cmdBuffer->copyImage(image->handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, move.newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                             { copy });
+
+        // Restore the layout the owner expects the image to be in. The old image is restored too,
+        // as it stays in use if the pass is ended without finishing the move.
+        carbon::Image::changeLayout(move.newImage, cmdBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layout, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                    VK_PIPELINE_STAGE_TRANSFER_BIT, range);
+        carbon::Image::changeLayout(image->handle, cmdBuffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                    VK_PIPELINE_STAGE_TRANSFER_BIT, range);
+    }
+}
+
+bool carbon::Defragmenter::endPass() {
+    std::vector<std::function<void()>> callbacks;
+    std::vector<carbon::Buffer*> movedBuffers;
+    VkResult result;
+    {
+        std::scoped_lock lock(defragMutex);
+        assert(context != nullptr);
+
+        for (const auto& move : pendingMoves) {
+            if (move.registration.buffer != nullptr) {
+                finishBufferMove(move);
+                movedBuffers.push_back(move.registration.buffer);
+            } else {
+                finishImageMove(move);
+            }
+            if (move.registration.onMoved)
+                callbacks.push_back(move.registration.onMoved);
+        }
+        pendingMoves.clear();
+
+        result = vmaEndDefragmentationPass(allocator, context, &passInfo);
+
+        // Only now do the allocations refer to their new memory.
+        for (auto* buffer : movedBuffers)
+            refreshBufferMemory(buffer);
+    }
+
+    // The owners might want to rewrite descriptors or unregister themselves.
+    for (auto& callback : callbacks)
+        callback();
+
+    return result == VK_INCOMPLETE;
+}
+
+void carbon::Defragmenter::finishBufferMove(const PendingMove& move) {
+    auto* buffer = move.registration.buffer;
+    vkDestroyBuffer(*device, buffer->handle, nullptr);
+    buffer->handle = move.newBuffer;
+
+    if (isFlagSet(buffer->bufferUsage, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)) {
+        auto addressInfo = carbon::Buffer::getBufferAddressInfo(buffer->handle);
+        buffer->address = carbon::Buffer::getBufferDeviceAddress(device, &addressInfo);
+    }
+
+    if (!buffer->name.empty())
+        device->setDebugUtilsName(buffer->handle, buffer->name);
+}
+
+void carbon::Defragmenter::refreshBufferMemory(carbon::Buffer* buffer) {
+    // The allocation handle itself stays the same, but now refers to the new memory.
+    if (buffer->mappedData != nullptr) {
+        VmaAllocationInfo allocationInfo = {};
+        vmaGetAllocationInfo(allocator, buffer->allocation, &allocationInfo);
+        buffer->mappedData = allocationInfo.pMappedData;
+    }
+
+    VkMemoryPropertyFlags allocationProperties = 0;
+    vmaGetAllocationMemoryProperties(allocator, buffer->allocation, &allocationProperties);
+    buffer->writeCombined = isFlagSet(allocationProperties, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+                            !isFlagSet(allocationProperties, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+}
+
+void carbon::Defragmenter::finishImageMove(const PendingMove& move) {
+    auto* image = move.registration.image;
+    vkDestroyImageView(*device, image->imageView, nullptr);
+    vkDestroyImage(*device, image->handle, nullptr);
+    image->handle = move.newImage;
+
+    image->viewInfo.image = image->handle;
+    auto result = vkCreateImageView(*device, &image->viewInfo, nullptr, &image->imageView);
+    checkResult(result, "Failed to recreate imageView after defragmentation");
+
+    if (!image->name.empty())
+        device->setDebugUtilsName(image->handle, image->name);
+}
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <fmt/core.h>
+
+#include <carbon/base/command_buffer.hpp>
+#include <carbon/base/command_pool.hpp>
+#include <carbon/base/device.hpp>
+#include <carbon/base/fence.hpp>
+#include <carbon/base/queue.hpp>
+#include <carbon/resource/filestreamer.hpp>
+#include <carbon/resource/image.hpp>
+#include <carbon/resource/mappedbuffer.hpp>
+#include <carbon/utils.hpp>
+
+carbon::MappedFile::~MappedFile() { close(); }
+
+void carbon::MappedFile::open(const std::filesystem::path& path) {
+    close();
+    size = std::filesystem::file_size(path);
+    if (size == 0)
+        return;
+
+#ifdef _WIN32
+    fileHandle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        fileHandle = nullptr;
+        throw std::runtime_error(fmt::format("Failed to open file {}", path.string()));
+    }
+    mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle != nullptr)
+        data = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+    fileDescriptor = ::open(path.c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+        throw std::runtime_error(fmt::format("Failed to open file {}", path.string()));
+    auto* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    if (mapping != MAP_FAILED)
+        data = static_cast<const uint8_t*>(mapping);
+#endif
+
+    if (data == nullptr) {
+        close();
+        throw std::runtime_error(fmt::format("Failed to map file {}", path.string()));
+    }
+}
+
+void carbon::MappedFile::close() {
+#ifdef _WIN32
+    if (data != nullptr)
+        UnmapViewOfFile(data);
+    if (mappingHandle != nullptr)
+        CloseHandle(mappingHandle);
+    if (fileHandle != nullptr)
+        CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (data != nullptr)
+        munmap(const_cast<uint8_t*>(data), size);
+    if (fileDescriptor >= 0)
+        ::close(fileDescriptor);
+    fileDescriptor = -1;
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+void carbon::MappedFile::willNeed(size_t offset, size_t rangeSize) const {
+    if (data == nullptr || offset >= size)
+        return;
+    rangeSize = std::min(rangeSize, size - offset);
+
+#ifdef _WIN32
+    WIN32_MEMORY_RANGE_ENTRY range = {
+        .VirtualAddress = const_cast<uint8_t*>(data + offset),
+        .NumberOfBytes = rangeSize,
+    };
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    // madvise requires a page aligned address.
+    static const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const auto alignedOffset = offset & ~(pageSize - 1);
+    madvise(const_cast<uint8_t*>(data + alignedOffset), rangeSize + (offset - alignedOffset), MADV_WILLNEED);
+#endif
+}
+
+auto carbon::MappedFile::getData() const -> const uint8_t* { return data; }
+
+auto carbon::MappedFile::getSize() const -> size_t { return size; }
+
+auto carbon::StreamStatistics::getThroughput() const -> double {
+    const auto seconds = copySeconds + waitSeconds;
+    return seconds > 0.0 ? static_cast<double>(bytesStreamed) / seconds : 0.0;
+}
+
+carbon::FileStreamer::FileStreamer(std::shared_ptr<carbon::Device> device, VmaAllocator allocator, std::string name)
+    : device(std::move(device)), allocator(allocator), name(std::move(name)) {}
+
+carbon::FileStreamer::~FileStreamer() = default;
+
+void carbon::FileStreamer::create(std::shared_ptr<carbon::Queue> newQueue, uint32_t queueFamilyIndex, VkDeviceSize newChunkSize,
+                                  uint32_t slotCount) {
+    queue = std::move(newQueue);
+    chunkSize = newChunkSize;
+
+    // Every slot re-records its command buffer, which is implicitly reset by beginning it.
+    commandPool = std::make_unique<carbon::CommandPool>(device, name + "_pool");
+    commandPool->create(queueFamilyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+
+    slots.resize(slotCount);
+    for (uint32_t i = 0; i < slotCount; ++i) {
+        auto& slot = slots[i];
+        slot.buffer = std::make_unique<carbon::MappedBuffer>(device.get(), allocator, fmt::format("{}_staging{}", name, i));
+        slot.buffer->create(chunkSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+        slot.fence = std::make_unique<carbon::Fence>(device, fmt::format("{}_fence{}", name, i));
+        slot.fence->create();
+        slot.cmdBuffer = commandPool->allocateBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    }
+}
+
+void carbon::FileStreamer::destroy() {
+    flush();
+
+    std::scoped_lock lock(streamMutex);
+    for (auto& slot : slots) {
+        slot.buffer->destroy();
+        slot.fence->destroy();
+    }
+    slots.clear();
+
+    if (commandPool != nullptr)
+        commandPool->destroy();
+}
+
+auto carbon::FileStreamer::fillNextSlot(const carbon::MappedFile& file, size_t fileOffset, VkDeviceSize copySize) -> StagingSlot& {
+    auto& slot = slots[nextSlot];
+    nextSlot = (nextSlot + 1) % slots.size();
+
+    if (slot.inFlight) {
+        auto waitStart = std::chrono::steady_clock::now();
+        if (!slot.fence->isSignaled()) {
+            ++statistics.stalls;
+            slot.fence->wait();
+        }
+        slot.fence->reset();
+        slot.inFlight = false;
+        statistics.waitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+    }
+
+    // Ask the OS to read ahead the following chunk while we copy this one.
+    file.willNeed(fileOffset + copySize, chunkSize);
+
+    auto copyStart = std::chrono::steady_clock::now();
+    slot.buffer->writeRange(file.getData() + fileOffset, copySize, 0);
+    statistics.copySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - copyStart).count();
+    statistics.bytesStreamed += copySize;
+    return slot;
+}
+
+void carbon::FileStreamer::submitSlot(StagingSlot& slot) {
+    VkCommandBuffer cmdBufferHandle = *slot.cmdBuffer;
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &cmdBufferHandle,
+    };
+
+    auto queueLock = queue->getLock();
+    auto result = queue->submit(slot.fence.get(), &submitInfo);
+    checkResult(queue.get(), result, "Failed to submit streaming copy");
+    slot.inFlight = true;
+    ++statistics.chunksSubmitted;
+}
+
+void carbon::FileStreamer::streamToBuffer(const carbon::MappedFile& file, size_t fileOffset, VkDeviceSize size,
+                                          const carbon::Buffer* destination, VkDeviceSize dstOffset) {
+    if (fileOffset + size > file.getSize())
+        throw std::runtime_error(fmt::format("Streamed range exceeds the file size of {} bytes", file.getSize()));
+
+    std::scoped_lock lock(streamMutex);
+    file.willNeed(fileOffset, std::min(size, chunkSize));
+
+    for (VkDeviceSize offset = 0; offset < size; offset += chunkSize) {
+        const auto copySize = std::min(chunkSize, size - offset);
+        auto& slot = fillNextSlot(file, fileOffset + offset, copySize);
+
+        VkBufferCopy copy = {
+            .srcOffset = 0,
+            .dstOffset = dstOffset + offset,
+            .size = copySize,
+        };
+        slot.cmdBuffer->begin();
+        slot.cmdBuffer->copyBuffer(slot.buffer->getHandle(), destination->getHandle(), { copy });
+        slot.cmdBuffer->end(queue.get());
+        submitSlot(slot);
+    }
+}
+
+void carbon::FileStreamer::streamToImage(const carbon::MappedFile& file, size_t fileOffset, VkDeviceSize size,
+                                         const carbon::Image* destination, VkImageLayout imageLayout, VkBufferImageCopy region) {
+    if (fileOffset + size > file.getSize())
+        throw std::runtime_error(fmt::format("Streamed range exceeds the file size of {} bytes", file.getSize()));
+    if (size > chunkSize)
+        throw std::runtime_error(fmt::format("Streamed image region of {} bytes exceeds the chunk size of {} bytes", size, chunkSize));
+
+    std::scoped_lock lock(streamMutex);
+    auto& slot = fillNextSlot(file, fileOffset, size);
+
+    region.bufferOffset = 0;
+    slot.cmdBuffer->begin();
+    slot.cmdBuffer->copyBufferToImage(slot.buffer->getHandle(), VkImage(*destination), imageLayout, { region });
+    slot.cmdBuffer->end(queue.get());
+    submitSlot(slot);
+}
+
+void carbon::FileStreamer::flush() {
+    std::scoped_lock lock(streamMutex);
+    for (auto& slot : slots) {
+        if (!slot.inFlight)
+            continue;
+        slot.fence->wait();
+        slot.fence->reset();
+        slot.inFlight = false;
+    }
+}
+
+auto carbon::FileStreamer::getStatistics() -> carbon::StreamStatistics {
+    std::scoped_lock lock(streamMutex);
+    return statistics;
+}
+
+void carbon::FileStreamer::resetStatistics() {
+    std::scoped_lock lock(streamMutex);
+    statistics = {};
+}
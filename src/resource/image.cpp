@@ -2,6 +2,8 @@
 
 #include <carbon/base/command_buffer.hpp>
 #include <carbon/base/device.hpp>
+#include <carbon/base/memory_budget.hpp>
+#include <carbon/base/queue.hpp>
 #include <carbon/resource/image.hpp>
 #include <carbon/utils.hpp>
 
@@ -42,7 +44,8 @@ void carbon::Image::create(const VkFormat newFormat, const VkImageUsageFlags usa
     allocationInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
     allocationInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-    vmaCreateImage(allocator, &imageCreateInfo, &allocationInfo, &handle, &allocation, nullptr);
+    auto result = createAllocation(&imageCreateInfo, &allocationInfo);
+    checkResult(result, "Failed to create image");
 
     VkImageViewCreateInfo imageViewCreateInfo = {};
     imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -58,6 +61,7 @@ void carbon::Image::create(const VkFormat newFormat, const VkImageUsageFlags usa
     imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 
     vkCreateImageView(*device, &imageViewCreateInfo, nullptr, &imageView);
+    viewInfo = imageViewCreateInfo;
     device->setDebugUtilsName(handle, name);
 }
 
@@ -69,15 +73,54 @@ void carbon::Image::create(VkImageCreateInfo* imageCreateInfo, VkImageViewCreate
         .requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
     };
 
-    auto result = vmaCreateImage(allocator, imageCreateInfo, &allocationInfo, &handle, &allocation, nullptr);
+    auto result = createAllocation(imageCreateInfo, &allocationInfo);
     checkResult(result, "Failed to create image");
 
     viewCreateInfo->image = handle;
     result = vkCreateImageView(*device, viewCreateInfo, nullptr, &imageView);
     checkResult(result, "Failed to create imageView");
+    viewInfo = *viewCreateInfo;
+    viewInfo.pNext = nullptr;
     device->setDebugUtilsName(handle, name);
 }
 
+auto carbon::Image::createAllocation(const VkImageCreateInfo* imageCreateInfo, const VmaAllocationCreateInfo* allocationInfo) -> VkResult {
+    imageInfo = *imageCreateInfo;
+    imageInfo.pNext = nullptr;
+
+    auto* budget = device->getMemoryBudget();
+    const auto heapIndex = budget != nullptr ? budget->getHeapIndex(allocationInfo->requiredFlags) : VK_MAX_MEMORY_HEAPS;
+    if (heapIndex == VK_MAX_MEMORY_HEAPS)
+        return vmaCreateImage(allocator, imageCreateInfo, allocationInfo, &handle, &allocation, nullptr);
+
+    // The image is created before its memory, so that its size is known and other resources
+    // can be evicted before the allocation would exceed the budget. Once the driver itself runs
+    // out of memory, it is too late for that.
+    auto result = vkCreateImage(*device, imageCreateInfo, nullptr, &handle);
+    if (result != VK_SUCCESS) {
+        handle = nullptr;
+        return result;
+    }
+    VkMemoryRequirements requirements = {};
+    vkGetImageMemoryRequirements(*device, handle, &requirements);
+    budget->ensureAvailable(heapIndex, requirements.size);
+
+    result = vmaAllocateMemoryForImage(allocator, handle, allocationInfo, &allocation, nullptr);
+    if (result == VK_SUCCESS)
+        result = vmaBindImageMemory(allocator, allocation, handle);
+    if (result != VK_SUCCESS) {
+        if (allocation != nullptr)
+            vmaFreeMemory(allocator, allocation);
+        vkDestroyImage(*device, handle, nullptr);
+        handle = nullptr;
+        allocation = nullptr;
+        return result;
+    }
+
+    budget->trackAllocation(allocation, name);
+    return result;
+}
+
 void carbon::Image::copyImage(carbon::CommandBuffer* cmdBuffer, VkImage destination, VkImageLayout destinationLayout) {
     VkImageCopy copyRegion = {
         .srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
@@ -86,13 +129,31 @@ void carbon::Image::copyImage(carbon::CommandBuffer* cmdBuffer, VkImage destinat
         .dstOffset = { 0, 0, 0 },
         .extent = getImageSize3d(),
     };
-    vkCmdCopyImage(*cmdBuffer, this->handle, this->getImageLayout(), destination, destinationLayout, 1, &copyRegion);
+    cmdBuffer->copyImage(this->handle, this->getImageLayout(), destination, destinationLayout, { copyRegion });
 }
 
 void carbon::Image::destroy() {
     vkDestroyImageView(*device, imageView, nullptr);
-    if (allocation != nullptr) // Swapchain images have no allocation.
+    if (allocation != nullptr) { // Swapchain images have no allocation.
+        if (auto* budget = device->getMemoryBudget(); budget != nullptr)
+            budget->untrackAllocation(allocation);
         vmaDestroyImage(allocator, handle, allocation);
+    }
+    imageView = nullptr;
+    handle = nullptr;
+    allocation = nullptr;
+}
+
+void carbon::Image::retire(const carbon::Queue* queue, uint64_t value) {
+    auto destroy = [device = device.get(), allocator = allocator, handle = handle, imageView = imageView, allocation = allocation]() {
+        vkDestroyImageView(*device, imageView, nullptr);
+        if (allocation != nullptr) {
+            if (auto* budget = device->getMemoryBudget(); budget != nullptr)
+                budget->untrackAllocation(allocation);
+            vmaDestroyImage(allocator, handle, allocation);
+        }
+    };
+    device->retire(queue, value, std::move(destroy));
     imageView = nullptr;
     handle = nullptr;
     allocation = nullptr;
@@ -129,6 +190,60 @@ void carbon::Image::changeLayout(carbon::CommandBuffer* cmdBuffer, const VkImage
     currentLayouts[subresourceRange.baseMipLevel] = newLayout;
 }
 
+void carbon::Image::transition(carbon::CommandBuffer* cmdBuffer, carbon::ResourceUsage srcUsage, carbon::ResourceUsage dstUsage,
+                               const VkImageSubresourceRange& subresourceRange) {
+    cmdBuffer->imageBarrier(handle, srcUsage, dstUsage, subresourceRange);
+    currentLayouts[subresourceRange.baseMipLevel] = carbon::getResourceUsageInfo(dstUsage).imageLayout;
+}
+
+void carbon::Image::releaseOwnership(carbon::CommandBuffer* cmdBuffer, const carbon::Queue* srcQueue, const carbon::Queue* dstQueue,
+                                     VkImageLayout newLayout, const VkImageSubresourceRange& subresourceRange,
+                                     VkPipelineStageFlags srcStage, VkAccessFlags srcAccess) {
+    if (srcQueue->getFamilyIndex() == dstQueue->getFamilyIndex())
+        return;
+
+    // The layout transition happens between the release and the acquire, which both have to
+    // specify the same layouts. The tracked layout is therefore only updated by the acquire.
+    VkImageMemoryBarrier imageBarrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = srcAccess,
+        .dstAccessMask = 0,
+        .oldLayout = currentLayouts[subresourceRange.baseMipLevel],
+        .newLayout = newLayout,
+        .srcQueueFamilyIndex = srcQueue->getFamilyIndex(),
+        .dstQueueFamilyIndex = dstQueue->getFamilyIndex(),
+        .image = handle,
+        .subresourceRange = subresourceRange,
+    };
+    cmdBuffer->pipelineBarrier(srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+}
+
+void carbon::Image::acquireOwnership(carbon::CommandBuffer* cmdBuffer, const carbon::Queue* srcQueue, const carbon::Queue* dstQueue,
+                                     VkImageLayout newLayout, const VkImageSubresourceRange& subresourceRange,
+                                     VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkImageMemoryBarrier imageBarrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = dstAccess,
+        .oldLayout = currentLayouts[subresourceRange.baseMipLevel],
+        .newLayout = newLayout,
+        .srcQueueFamilyIndex = srcQueue->getFamilyIndex(),
+        .dstQueueFamilyIndex = dstQueue->getFamilyIndex(),
+        .image = handle,
+        .subresourceRange = subresourceRange,
+    };
+    VkPipelineStageFlags srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    if (srcQueue->getFamilyIndex() == dstQueue->getFamilyIndex()) {
+        // There was no release, so this has to be a regular barrier.
+        imageBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        srcStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    }
+    cmdBuffer->pipelineBarrier(srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+    currentLayouts[subresourceRange.baseMipLevel] = newLayout;
+}
+
 void carbon::Image::changeLayout(VkImage image, carbon::CommandBuffer* cmdBuffer, VkImageLayout oldLayout, VkImageLayout newLayout,
                                  VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
                                  const VkImageSubresourceRange& subresourceRange) {
@@ -0,0 +1,71 @@
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+
+#include <fmt/core.h>
+
+#include <carbon/base/command_buffer.hpp>
+#include <carbon/base/device.hpp>
+#include <carbon/resource/indirectbuffer.hpp>
+
+carbon::IndirectBuffer::IndirectBuffer(carbon::Device* device, VmaAllocator allocator, std::string name)
+    : Buffer(device, allocator, std::move(name)) {}
+
+void carbon::IndirectBuffer::create(uint32_t newMaxDrawCount, bool newHostWritable) {
+    maxDrawCount = newMaxDrawCount;
+    hostWritable = newHostWritable;
+    commands.reserve(maxDrawCount);
+
+    const auto bufferSize = commandOffset + static_cast<VkDeviceSize>(maxDrawCount) * commandStride;
+    const VkBufferUsageFlags usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    if (hostWritable) {
+        Buffer::create(bufferSize, usage, VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    } else {
+        Buffer::create(bufferSize, usage, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+}
+
+auto carbon::IndirectBuffer::addDraw(uint32_t indexCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t instanceCount,
+                                     uint32_t firstInstance) -> uint32_t {
+    if (commands.size() == maxDrawCount)
+        throw std::runtime_error(fmt::format("Indirect buffer is full with {} draws", maxDrawCount));
+
+    commands.push_back({
+        .indexCount = indexCount,
+        .instanceCount = instanceCount,
+        .firstIndex = firstIndex,
+        .vertexOffset = vertexOffset,
+        .firstInstance = firstInstance,
+    });
+    return static_cast<uint32_t>(commands.size() - 1);
+}
+
+void carbon::IndirectBuffer::clear() { commands.clear(); }
+
+void carbon::IndirectBuffer::upload() const {
+    assert(mappedData != nullptr);
+    const auto drawCount = getDrawCount();
+    memoryCopy(&drawCount, sizeof(drawCount), countOffset);
+    if (!commands.empty())
+        memoryCopy(commands.data(), commands.size() * sizeof(VkDrawIndexedIndirectCommand), commandOffset);
+}
+
+void carbon::IndirectBuffer::draw(carbon::CommandBuffer* cmdBuffer) const {
+    if (device->supportsDrawIndirectCount()) {
+        cmdBuffer->drawIndexedIndirectCount(this, commandOffset, this, countOffset, maxDrawCount, commandStride);
+        return;
+    }
+
+    // The count of draws built on the CPU is known here, which is not the case for draws the
+    // GPU wrote, e.g. after culling.
+    if (!hostWritable)
+        throw std::runtime_error("Drawing a GPU written indirect buffer requires VK_KHR_draw_indirect_count");
+    if (getDrawCount() > 0)
+        cmdBuffer->drawIndexedIndirect(this, commandOffset, getDrawCount(), commandStride);
+}
+
+auto carbon::IndirectBuffer::getDrawCount() const -> uint32_t { return static_cast<uint32_t>(commands.size()); }
+
+auto carbon::IndirectBuffer::getMaxDrawCount() const -> uint32_t { return maxDrawCount; }
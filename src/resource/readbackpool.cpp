@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+#include <carbon/base/command_buffer.hpp>
+#include <carbon/base/fence.hpp>
+#include <carbon/resource/buffer.hpp>
+#include <carbon/resource/image.hpp>
+#include <carbon/resource/readbackpool.hpp>
+
+carbon::ReadbackPool::ReadbackPool(carbon::Device* device, VmaAllocator allocator, std::string name)
+    : device(device), allocator(allocator), name(std::move(name)) {}
+
+carbon::ReadbackPool::~ReadbackPool() = default;
+
+void carbon::ReadbackPool::destroy() {
+    std::scoped_lock lock(poolMutex);
+    for (auto& [id, readback] : readbacks)
+        readback.buffer->destroy();
+    for (auto& buffer : freeBuffers)
+        buffer->destroy();
+    readbacks.clear();
+    freeBuffers.clear();
+}
+
+auto carbon::ReadbackPool::acquireBuffer(VkDeviceSize size) -> std::unique_ptr<carbon::Buffer> {
+    // Take the smallest free buffer that is big enough.
+    auto best = freeBuffers.end();
+    for (auto it = freeBuffers.begin(); it != freeBuffers.end(); ++it) {
+        if ((*it)->getSize() >= size && (best == freeBuffers.end() || (*it)->getSize() < (*best)->getSize()))
+            best = it;
+    }
+    if (best != freeBuffers.end()) {
+        auto buffer = std::move(*best);
+        freeBuffers.erase(best);
+        return buffer;
+    }
+
+    auto buffer = std::make_unique<carbon::Buffer>(device, allocator, name + "_buffer");
+    const auto bufferSize = carbon::Buffer::alignedSize(size, bufferGranularity);
+    const auto allocationFlags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
+    // Reading from uncached memory is extremely slow, so we prefer cached memory.
+    auto result = buffer->tryCreate(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, allocationFlags,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    if (result != VK_SUCCESS)
+        buffer->create(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, allocationFlags, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    return buffer;
+}
+
+auto carbon::ReadbackPool::insert(std::unique_ptr<carbon::Buffer> buffer, VkDeviceSize size, carbon::Fence* fence)
+    -> carbon::ReadbackHandle {
+    auto id = nextId++;
+    readbacks[id] = {
+        .buffer = std::move(buffer),
+        .size = size,
+        .fence = fence,
+    };
+    return { id };
+}
+
+auto carbon::ReadbackPool::readback(carbon::CommandBuffer* cmdBuffer, carbon::Fence* fence, const carbon::Buffer* source,
+                                    VkDeviceSize size, VkDeviceSize srcOffset) -> carbon::ReadbackHandle {
+    assert(fence != nullptr);
+    std::scoped_lock lock(poolMutex);
+    auto buffer = acquireBuffer(size);
+
+    VkMemoryBarrier memoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+    };
+    cmdBuffer->pipelineBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0,
+                               nullptr);
+
+    VkBufferCopy copy = {
+        .srcOffset = srcOffset,
+        .dstOffset = 0,
+        .size = size,
+    };
+    cmdBuffer->copyBuffer(source->getHandle(), buffer->getHandle(), { copy });
+
+    auto hostBarrier = buffer->getMemoryBarrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+    cmdBuffer->pipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+
+    return insert(std::move(buffer), size, fence);
+}
+
+auto carbon::ReadbackPool::readback(carbon::CommandBuffer* cmdBuffer, carbon::Fence* fence, const carbon::Image* source,
+                                    VkImageLayout imageLayout, VkBufferImageCopy region, VkDeviceSize size) -> carbon::ReadbackHandle {
+    assert(fence != nullptr);
+    std::scoped_lock lock(poolMutex);
+    auto buffer = acquireBuffer(size);
+
+    // Like the buffer readback, wait for all earlier writes to the image.
+    VkMemoryBarrier memoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+    };
+    cmdBuffer->pipelineBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0,
+                               nullptr);
+
+    region.bufferOffset = 0;
+    cmdBuffer->copyImageToBuffer(VkImage(*source), imageLayout, buffer->getHandle(), { region });
+
+    auto hostBarrier = buffer->getMemoryBarrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+    cmdBuffer->pipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+
+    return insert(std::move(buffer), size, fence);
+}
+
+bool carbon::ReadbackPool::checkCompleted(Readback& readback) {
+    // The fence might get reset and reused for a later submission, which is why we
+    // remember that the copy has finished once we have seen the fence signaled.
+    if (!readback.completed && readback.fence->isSignaled()) {
+        readback.buffer->invalidateMemory(0, readback.size);
+        readback.completed = true;
+    }
+    return readback.completed;
+}
+
+bool carbon::ReadbackPool::isReady(carbon::ReadbackHandle handle) {
+    std::scoped_lock lock(poolMutex);
+    auto readback = readbacks.find(handle.id);
+    return readback != readbacks.end() && checkCompleted(readback->second);
+}
+
+void carbon::ReadbackPool::wait(carbon::ReadbackHandle handle) {
+    carbon::Fence* fence = nullptr;
+    {
+        std::scoped_lock lock(poolMutex);
+        auto readback = readbacks.find(handle.id);
+        if (readback == readbacks.end() || checkCompleted(readback->second))
+            return;
+        fence = readback->second.fence;
+    }
+
+    // Don't hold the lock while waiting, so that other threads can still poll their readbacks.
+    // The wait throws on a timeout, which leaves the readback pending.
+    fence->wait();
+
+    std::scoped_lock lock(poolMutex);
+    auto readback = readbacks.find(handle.id);
+    if (readback != readbacks.end() && !readback->second.completed) {
+        readback->second.buffer->invalidateMemory(0, readback->second.size);
+        readback->second.completed = true;
+    }
+}
+
+auto carbon::ReadbackPool::getData(carbon::ReadbackHandle handle) const -> const void* {
+    std::scoped_lock lock(poolMutex);
+    auto readback = readbacks.find(handle.id);
+    if (readback == readbacks.end() || !readback->second.completed)
+        return nullptr;
+    return readback->second.buffer->getMappedData();
+}
+
+auto carbon::ReadbackPool::getSize(carbon::ReadbackHandle handle) const -> VkDeviceSize {
+    std::scoped_lock lock(poolMutex);
+    auto readback = readbacks.find(handle.id);
+    return readback != readbacks.end() ? readback->second.size : 0;
+}
+
+void carbon::ReadbackPool::release(carbon::ReadbackHandle handle) {
+    std::scoped_lock lock(poolMutex);
+    auto readback = readbacks.find(handle.id);
+    if (readback == readbacks.end())
+        return;
+
+    // A readback which is released before it completed may still be written to by the GPU.
+    if (!checkCompleted(readback->second))
+        readback->second.fence->wait();
+    freeBuffers.push_back(std::move(readback->second.buffer));
+    readbacks.erase(readback);
+}
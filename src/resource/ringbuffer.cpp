@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+
+#include <fmt/core.h>
+
+#include <carbon/base/fence.hpp>
+#include <carbon/resource/ringbuffer.hpp>
+
+carbon::RingBuffer::RingBuffer(carbon::Device* device, VmaAllocator allocator, std::string name)
+    : MappedBuffer(device, allocator, std::move(name)) {}
+
+void carbon::RingBuffer::create(uint64_t bufferSize, VkBufferUsageFlags bufferUsage) {
+    MappedBuffer::create(bufferSize, bufferUsage, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+    head = 0;
+    tail = 0;
+}
+
+void carbon::RingBuffer::destroy() {
+    frames.clear();
+    head = 0;
+    tail = 0;
+    carbon::Buffer::destroy();
+}
+
+void carbon::RingBuffer::reclaim() {
+    while (frames.size() > 1 && frames.front().fence->isSignaled()) {
+        tail = frames.front().end;
+        frames.pop_front();
+    }
+}
+
+void carbon::RingBuffer::beginFrame(carbon::Fence* fence) {
+    assert(fence != nullptr);
+
+    // Every frame up to the last one using this fence has to be finished,
+    // as the caller already waited on the fence to be able to reuse it.
+    auto reused = std::find_if(frames.rbegin(), frames.rend(), [fence](const FrameMarker& frame) { return frame.fence == fence; });
+    if (reused != frames.rend()) {
+        tail = reused->end;
+        frames.erase(frames.begin(), reused.base());
+    }
+
+    frames.push_back({ .fence = fence, .end = head });
+    reclaim();
+}
+
+auto carbon::RingBuffer::allocate(VkDeviceSize allocationSize, VkDeviceSize alignment) -> carbon::RingBufferAllocation {
+    if (frames.empty())
+        throw std::runtime_error("RingBuffer::beginFrame has to be called before allocating");
+    if (allocationSize > size)
+        throw std::runtime_error(fmt::format("Ring buffer allocation of {} bytes exceeds the buffer size of {} bytes", allocationSize, size));
+
+    uint64_t start = 0;
+    while (true) {
+        const uint64_t physical = head % size;
+        const uint64_t alignedPhysical = alignedSize(physical, alignment);
+
+        // If the allocation does not fit before the end of the buffer, the remaining bytes are
+        // skipped and we start at the beginning again. They are released together with this frame.
+        if (alignedPhysical + allocationSize > size) {
+            start = head + (size - physical);
+        } else {
+            start = head + (alignedPhysical - physical);
+        }
+
+        if (start + allocationSize - tail <= size)
+            break;
+
+        // The ring is full. First, release every frame that has already finished and
+        // otherwise block on the oldest frame still in flight.
+        auto previousTail = tail;
+        reclaim();
+        if (tail != previousTail)
+            continue;
+
+        if (frames.size() <= 1)
+            throw std::runtime_error(fmt::format("Ring buffer of {} bytes is too small for a single frame", size));
+
+        frames.front().fence->wait();
+        tail = frames.front().end;
+        frames.pop_front();
+    }
+
+    head = start + allocationSize;
+    frames.back().end = head;
+
+    const VkDeviceSize offset = start % size;
+    return {
+        .offset = offset,
+        .size = allocationSize,
+        .deviceAddress = address != 0 ? address + offset : 0,
+        .hostAddress = static_cast<uint8_t*>(mappedData) + offset,
+    };
+}
+
+auto carbon::RingBuffer::push(const void* data, VkDeviceSize dataSize, VkDeviceSize alignment) -> carbon::RingBufferAllocation {
+    auto allocation = allocate(dataSize, alignment);
+    writeRange(data, dataSize, allocation.offset);
+    return allocation;
+}
+
+auto carbon::RingBuffer::getUsedSize() const -> VkDeviceSize { return head - tail; }
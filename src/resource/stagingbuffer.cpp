@@ -1,41 +1,105 @@
 #include <carbon/base/command_buffer.hpp>
+#include <carbon/base/device.hpp>
+#include <carbon/base/physical_device.hpp>
 #include <carbon/resource/stagingbuffer.hpp>
+#include <carbon/utils.hpp>
 
 carbon::StagingBuffer::StagingBuffer(carbon::Device* device, VmaAllocator allocator, const std::string& name)
     : Buffer(device, allocator, "staging_" + name) {
     gpuBuffer = std::make_unique<carbon::Buffer>(device, allocator, name);
 }
 
-void carbon::StagingBuffer::create(uint64_t bufferSize, VkBufferUsageFlags additionalBufferUsage, VmaAllocationCreateFlags allocationFlags) {
+bool carbon::StagingBuffer::hasDirectMemoryBudget(VkDeviceSize bufferSize) const {
+    auto physicalDevice = device->getPhysicalDevice();
+    const auto& properties = physicalDevice->getMemoryProperties(nullptr)->memoryProperties;
+
+    uint32_t heapIndex = VK_MAX_MEMORY_HEAPS;
+    for (uint32_t i = 0; i < properties.memoryTypeCount; ++i) {
+        const auto& type = properties.memoryTypes[i];
+        if (isFlagSet(type.propertyFlags, directMemoryProperties) && properties.memoryHeaps[type.heapIndex].size > minDirectHeapSize) {
+            heapIndex = type.heapIndex;
+            break;
+        }
+    }
+    if (heapIndex == VK_MAX_MEMORY_HEAPS)
+        return false;
+
+    VkDeviceSize heapUsage = 0, heapBudget = 0;
+    if (physicalDevice->supportsExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+        };
+        physicalDevice->getMemoryProperties(&budgetProperties);
+        heapUsage = budgetProperties.heapUsage[heapIndex];
+        heapBudget = budgetProperties.heapBudget[heapIndex];
+    } else {
+        // Without VK_EXT_memory_budget, VMA estimates the budget from its own allocations.
+        VmaBudget budgets[VK_MAX_MEMORY_HEAPS] = {};
+        vmaGetHeapBudgets(allocator, budgets);
+        heapUsage = budgets[heapIndex].usage;
+        heapBudget = budgets[heapIndex].budget;
+    }
+
+    return static_cast<double>(heapUsage + bufferSize) <= static_cast<double>(heapBudget) * maxDirectBudgetUsage;
+}
+
+void carbon::StagingBuffer::create(uint64_t bufferSize, VkBufferUsageFlags additionalBufferUsage, VmaAllocationCreateFlags allocationFlags,
+                                   VkBufferUsageFlags destinationUsage) {
+    directlyMapped = false;
+    if (destinationUsage != 0 && hasDirectMemoryBudget(bufferSize)) {
+        auto result = Buffer::tryCreate(bufferSize, srcBufferUsage | dstBufferUsage | additionalBufferUsage | destinationUsage,
+                                        allocationFlags | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, directMemoryProperties);
+        // The heap might have filled up in the meantime, in which case we silently fall back to
+        // a regular staging buffer.
+        if (result == VK_SUCCESS) {
+            directlyMapped = true;
+            return;
+        }
+    }
+
     Buffer::create(bufferSize, srcBufferUsage | additionalBufferUsage, srcAllocationFlags | allocationFlags, srcMemoryProperties);
 }
 
 void carbon::StagingBuffer::createDestinationBuffer(VkBufferUsageFlags usage) {
+    if (directlyMapped)
+        return;
     if (size != 0 && handle != nullptr) {
         gpuBuffer->create(size, dstBufferUsage | usage, 0);
     }
 }
 
-void carbon::StagingBuffer::copyIntoVram(carbon::CommandBuffer* cmdBuffer) { copyToBuffer(cmdBuffer, gpuBuffer.get()); }
+void carbon::StagingBuffer::copyIntoVram(carbon::CommandBuffer* cmdBuffer) {
+    if (directlyMapped)
+        return;
+    copyToBuffer(cmdBuffer, gpuBuffer.get());
+}
 
 void carbon::StagingBuffer::destroy() {
     gpuBuffer->destroy();
     carbon::Buffer::destroy();
 }
 
-VkBuffer carbon::StagingBuffer::getDestinationHandle() const { return gpuBuffer->getHandle(); }
+void carbon::StagingBuffer::retire(const carbon::Queue* queue, uint64_t value) {
+    gpuBuffer->retire(queue, value);
+    carbon::Buffer::retire(queue, value);
+}
+
+VkBuffer carbon::StagingBuffer::getDestinationHandle() const { return directlyMapped ? handle : gpuBuffer->getHandle(); }
+
+bool carbon::StagingBuffer::isDirectlyMapped() const { return directlyMapped; }
 
 VkDescriptorBufferInfo carbon::StagingBuffer::getDescriptorInfo(uint64_t rangeSize, uint64_t offset) const {
     return {
-        .buffer = gpuBuffer->getHandle(),
+        .buffer = getDestinationHandle(),
         .offset = offset,
         .range = rangeSize,
     };
 }
 
-VkDeviceAddress carbon::StagingBuffer::getDeviceAddress() const { return gpuBuffer->getDeviceAddress(); }
+VkDeviceAddress carbon::StagingBuffer::getDeviceAddress() const { return directlyMapped ? address : gpuBuffer->getDeviceAddress(); }
 
 void carbon::StagingBuffer::resize(VkDeviceSize newSize) {
     carbon::Buffer::resize(newSize);
-    gpuBuffer->resize(newSize);
+    if (!directlyMapped)
+        gpuBuffer->resize(newSize);
 }
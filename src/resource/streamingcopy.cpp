@@ -0,0 +1,107 @@
+#include <cstdint>
+#include <cstring>
+
+#include <carbon/resource/streamingcopy.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CARBON_STREAMING_COPY_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CARBON_TARGET_AVX2
+#else
+#define CARBON_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+    // Below this size, the setup and the fence cost more than they save.
+    constexpr size_t minStreamingSize = 256;
+
+#ifdef CARBON_STREAMING_COPY_X86
+    // Copies the bytes up to the next aligned destination address with a regular memcpy.
+    template <size_t Alignment>
+    size_t copyHead(uint8_t*& dst, const uint8_t*& src, size_t size) {
+        const auto misalignment = reinterpret_cast<uintptr_t>(dst) & (Alignment - 1);
+        const size_t head = misalignment == 0 ? 0 : Alignment - misalignment;
+        std::memcpy(dst, src, head);
+        dst += head;
+        src += head;
+        return size - head;
+    }
+
+    void copySse2(void* destination, const void* source, size_t size) {
+        auto* dst = static_cast<uint8_t*>(destination);
+        auto* src = static_cast<const uint8_t*>(source);
+        size = copyHead<16>(dst, src, size);
+
+        // Four stores per iteration fill a whole 64 byte write-combining buffer.
+        for (; size >= 64; size -= 64, dst += 64, src += 64) {
+            auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+            auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+            auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48));
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst), a);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 16), b);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32), c);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 48), d);
+        }
+        _mm_sfence();
+        std::memcpy(dst, src, size);
+    }
+
+    CARBON_TARGET_AVX2 void copyAvx2(void* destination, const void* source, size_t size) {
+        auto* dst = static_cast<uint8_t*>(destination);
+        auto* src = static_cast<const uint8_t*>(source);
+        size = copyHead<32>(dst, src, size);
+
+        for (; size >= 128; size -= 128, dst += 128, src += 128) {
+            auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+            auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 32));
+            auto c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 64));
+            auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 96));
+            _mm256_stream_si256(reinterpret_cast<__m256i*>(dst), a);
+            _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 32), b);
+            _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 64), c);
+            _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 96), d);
+        }
+        _mm_sfence();
+        _mm256_zeroupper();
+        std::memcpy(dst, src, size);
+    }
+
+    bool supportsAvx2() {
+#ifdef _MSC_VER
+        int info[4] = {};
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        // AVX has to be supported and enabled by the OS using XSAVE.
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    using CopyFunction = void (*)(void*, const void*, size_t);
+
+    CopyFunction selectCopyFunction() { return supportsAvx2() ? copyAvx2 : copySse2; }
+#endif // #ifdef CARBON_STREAMING_COPY_X86
+} // namespace
+
+void carbon::streamingCopy(void* destination, const void* source, size_t size) {
+#ifdef CARBON_STREAMING_COPY_X86
+    if (size >= minStreamingSize) {
+        static const CopyFunction copyFunction = selectCopyFunction();
+        copyFunction(destination, source, size);
+        return;
+    }
+#endif
+    std::memcpy(destination, source, size);
+}
@@ -99,8 +99,8 @@ void carbon::Texture::generateMipmaps(carbon::CommandBuffer* cmdBuffer) {
         // We want half the size of the previous mip for this mip level.
         blit.dstOffsets[1] = { mipWidth > 1 ? static_cast<int32_t>(mipWidth / 2) : 1,
                                mipHeight > 1 ? static_cast<int32_t>(mipHeight / 2) : 1, 1 };
-        vkCmdBlitImage(*cmdBuffer, *this, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, *this, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
-                       VK_FILTER_LINEAR);
+        cmdBuffer->blitImage(*this, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, *this, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, { blit },
+                             VK_FILTER_LINEAR);
 
         // Make sure this mip is not used again until this buffer is finished.
         changeLayout(cmdBuffer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, { VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 1, 0, 1 },
@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <utility>
+
+#include <carbon/base/command_buffer.hpp>
+#include <carbon/base/command_pool.hpp>
+#include <carbon/base/device.hpp>
+#include <carbon/base/queue.hpp>
+#include <carbon/resource/image.hpp>
+#include <carbon/resource/mappedbuffer.hpp>
+#include <carbon/resource/uploadbatcher.hpp>
+
+carbon::UploadBatcher::UploadBatcher(std::shared_ptr<carbon::Device> device, VmaAllocator allocator, std::string name)
+    : device(std::move(device)), allocator(allocator), name(std::move(name)) {}
+
+carbon::UploadBatcher::~UploadBatcher() = default;
+
+void carbon::UploadBatcher::create(std::shared_ptr<carbon::Queue> newQueue, uint32_t queueFamilyIndex, VkDeviceSize stagingBlockSize) {
+    queue = std::move(newQueue);
+    blockSize = stagingBlockSize;
+
+    commandPool = std::make_unique<carbon::CommandPool>(device, name + "_pool");
+    commandPool->create(queueFamilyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+}
+
+void carbon::UploadBatcher::destroy() {
+    std::scoped_lock lock(batchMutex);
+    while (!inFlightBatches.empty())
+        retireOldest();
+
+    for (auto& block : blocks)
+        block.buffer->destroy();
+    for (auto& block : freeBlocks)
+        block.buffer->destroy();
+    blocks.clear();
+    freeBlocks.clear();
+    bufferCopies.clear();
+    imageCopies.clear();
+
+    if (commandPool != nullptr)
+        commandPool->destroy();
+}
+
+auto carbon::UploadBatcher::stage(const void* data, VkDeviceSize dataSize) -> std::pair<VkBuffer, VkDeviceSize> {
+    // Find a block of the current batch which still has enough space left.
+    for (auto& block : blocks) {
+        auto offset = carbon::Buffer::alignedSize(block.used, stagingAlignment);
+        if (offset + dataSize <= block.buffer->getSize()) {
+            block.buffer->memoryCopy(data, dataSize, offset);
+            block.used = offset + dataSize;
+            return { block.buffer->getHandle(), offset };
+        }
+    }
+
+    // Reuse a previously freed block, or create a new one. Uploads bigger
+    // than a single block get their own dedicated staging block.
+    if (dataSize <= blockSize && !freeBlocks.empty()) {
+        blocks.push_back(std::move(freeBlocks.back()));
+        freeBlocks.pop_back();
+    } else {
+        StagingBlock block = {
+            .buffer = std::make_unique<carbon::MappedBuffer>(device.get(), allocator, name + "_staging"),
+        };
+        block.buffer->create(std::max(blockSize, dataSize), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                             VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+        blocks.push_back(std::move(block));
+    }
+
+    auto& block = blocks.back();
+    block.buffer->memoryCopy(data, dataSize, 0);
+    block.used = dataSize;
+    return { block.buffer->getHandle(), 0 };
+}
+
+void carbon::UploadBatcher::upload(const carbon::Buffer* destination, const void* data, VkDeviceSize dataSize, VkDeviceSize dstOffset) {
+    if (dataSize == 0)
+        return;
+
+    std::scoped_lock lock(batchMutex);
+    auto [stagingHandle, srcOffset] = stage(data, dataSize);
+    bufferCopies[{ stagingHandle, destination->getHandle() }].push_back({
+        .srcOffset = srcOffset,
+        .dstOffset = dstOffset,
+        .size = dataSize,
+    });
+}
+
+void carbon::UploadBatcher::upload(const carbon::Image* destination, VkImageLayout imageLayout, const void* data, VkDeviceSize dataSize,
+                                   VkBufferImageCopy region) {
+    if (dataSize == 0)
+        return;
+
+    std::scoped_lock lock(batchMutex);
+    auto [stagingHandle, srcOffset] = stage(data, dataSize);
+    region.bufferOffset = srcOffset;
+    imageCopies[{ stagingHandle, VkImage(*destination), imageLayout }].push_back(region);
+}
+
+auto carbon::UploadBatcher::submit() -> carbon::UploadToken {
+    std::scoped_lock lock(batchMutex);
+    if (bufferCopies.empty() && imageCopies.empty())
+        return { lastSubmittedBatch, inFlightBatches.empty() ? 0 : inFlightBatches.back().timelineValue };
+
+    auto cmdBuffer = commandPool->allocateBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    cmdBuffer->begin();
+    for (const auto& [buffers, regions] : bufferCopies) {
+        cmdBuffer->copyBuffer(buffers.first, buffers.second, regions);
+    }
+    for (const auto& [target, regions] : imageCopies) {
+        cmdBuffer->copyBufferToImage(std::get<0>(target), std::get<1>(target), std::get<2>(target), regions);
+    }
+    cmdBuffer->end(queue.get());
+
+    VkCommandBuffer cmdBufferHandle = *cmdBuffer;
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &cmdBufferHandle,
+    };
+
+    // The queue's timeline tracks the batch, so no fence has to be created for it.
+    const auto timelineValue = queue->submit(&submitInfo);
+
+    inFlightBatches.push_back({
+        .batch = ++lastSubmittedBatch,
+        .timelineValue = timelineValue,
+        .cmdBuffer = std::move(cmdBuffer),
+        .blocks = std::move(blocks),
+    });
+    blocks.clear();
+    bufferCopies.clear();
+    imageCopies.clear();
+
+    return { lastSubmittedBatch, timelineValue };
+}
+
+void carbon::UploadBatcher::retireOldest() {
+    auto& batch = inFlightBatches.front();
+    queue->wait(batch.timelineValue);
+    commandPool->freeBuffers({ batch.cmdBuffer.get() });
+
+    for (auto& block : batch.blocks) {
+        // Dedicated blocks for oversized uploads are not worth keeping around.
+        if (block.buffer->getSize() > blockSize) {
+            block.buffer->destroy();
+            continue;
+        }
+        block.used = 0;
+        freeBlocks.push_back(std::move(block));
+    }
+
+    lastCompletedBatch = batch.batch;
+    inFlightBatches.pop_front();
+}
+
+void carbon::UploadBatcher::retireCompleted() {
+    while (!inFlightBatches.empty() && queue->isComplete(inFlightBatches.front().timelineValue))
+        retireOldest();
+}
+
+bool carbon::UploadBatcher::isComplete(carbon::UploadToken token) {
+    std::scoped_lock lock(batchMutex);
+    retireCompleted();
+    return token.batch <= lastCompletedBatch;
+}
+
+void carbon::UploadBatcher::wait(carbon::UploadToken token) {
+    std::scoped_lock lock(batchMutex);
+    while (token.batch > lastCompletedBatch && !inFlightBatches.empty())
+        retireOldest();
+}
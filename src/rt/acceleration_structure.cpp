@@ -56,6 +56,20 @@ void carbon::AccelerationStructure::destroy() {
     mutex.unlock();
 }
 
+void carbon::AccelerationStructure::retire(const carbon::Queue* queue, uint64_t value) {
+    std::scoped_lock lock(mutex);
+    if (handle != nullptr) {
+        device->retire(queue, value,
+                       [device = device, handle = handle]() { device->vkDestroyAccelerationStructureKHR(*device, handle, nullptr); });
+        handle = nullptr;
+        address = 0;
+    }
+    if (resultBuffer != nullptr)
+        resultBuffer->retire(queue, value);
+    if (scratchBuffer != nullptr)
+        scratchBuffer->retire(queue, value);
+}
+
 VkAccelerationStructureBuildSizesInfoKHR
 carbon::AccelerationStructure::getBuildSizes(const uint32_t* primitiveCount, VkAccelerationStructureBuildGeometryInfoKHR* buildGeometryInfo,
                                              VkPhysicalDeviceAccelerationStructurePropertiesKHR asProperties) {
@@ -106,9 +120,13 @@ void carbon::BottomLevelAccelerationStructure::createMeshBuffers(std::vector<Pri
         totalIndexSize += prim.second.size();
     }
 
-    vertexBuffer->create(totalVertexSize);
-    indexBuffer->create(totalIndexSize);
-    transformBuffer->create(sizeof(VkTransformMatrixKHR));
+    // On devices with ReBAR or unified memory, the staging buffers can already be
+    // used as the inputs of the build, which removes the copies into VRAM.
+    VkBufferUsageFlags asInputBufferUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+                                            VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+    vertexBuffer->create(totalVertexSize, 0, VMA_ALLOCATION_CREATE_MAPPED_BIT, asInputBufferUsage);
+    indexBuffer->create(totalIndexSize, 0, VMA_ALLOCATION_CREATE_MAPPED_BIT, asInputBufferUsage);
+    transformBuffer->create(sizeof(VkTransformMatrixKHR), 0, VMA_ALLOCATION_CREATE_MAPPED_BIT, asInputBufferUsage);
 
     // Copy the data into the big buffer at an offset.
     uint64_t currentVertexOffset = 0, currentIndexOffset = 0;
@@ -126,8 +144,6 @@ void carbon::BottomLevelAccelerationStructure::createMeshBuffers(std::vector<Pri
     transformBuffer->memoryCopy(&transform, sizeof(VkTransformMatrixKHR));
 
     // At last, we create the real buffers that reside on the GPU.
-    VkBufferUsageFlags asInputBufferUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-                                            VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
     vertexBuffer->createDestinationBuffer(asInputBufferUsage);
     indexBuffer->createDestinationBuffer(asInputBufferUsage);
     transformBuffer->createDestinationBuffer(asInputBufferUsage);
@@ -150,5 +166,12 @@ void carbon::BottomLevelAccelerationStructure::destroy() {
     carbon::AccelerationStructure::destroy(); /* Call base */
 }
 
+void carbon::BottomLevelAccelerationStructure::retire(const carbon::Queue* queue, uint64_t value) {
+    vertexBuffer->retire(queue, value);
+    indexBuffer->retire(queue, value);
+    transformBuffer->retire(queue, value);
+    carbon::AccelerationStructure::retire(queue, value);
+}
+
 carbon::TopLevelAccelerationStructure::TopLevelAccelerationStructure(std::shared_ptr<carbon::Device> device, VmaAllocator allocator)
     : AccelerationStructure(device, allocator, carbon::AccelerationStructureType::TopLevel, "tlas") {}